@@ -1,4 +1,4 @@
-#include <els_elapsedMillis.h>
+#include <clock.h>
 
 #include <cstdint>
 
@@ -13,7 +13,7 @@ class Axis {
   volatile int m_currentPosition;
 
   // the timestamp of the last pulse
-  elapsedMicros m_lastPulseMicros;
+  elapsedMicros64 m_lastPulseMicros;
 
   // the elapsed time for the last full pulse duration
   uint32_t m_lastFullPulseDurationMicros;
@@ -76,4 +76,10 @@ class DrivenAxis {
   virtual int getExpectedPosition() = 0;
   virtual void update() = 0;
   virtual int getPositionError() = 0;
+  /**
+   * The Clock time update() next has to be called by, 0 if it has to be called
+   * every tick and UINT64_MAX if there is nothing to do until it is told to
+   * move. Used by the StepScheduler to skip axes that are waiting
+   */
+  virtual uint64_t getNextUpdateMicros() = 0;
 };
@@ -0,0 +1,15 @@
+#include <cstdint>
+
+#pragma once
+
+/**
+ * This defines the HW interface for the buttons, abstracted away from the
+ * actual calls so we can test it more easily
+ */
+class ButtonIO {
+ public:
+  /**
+   * Sample every button at once, bit n is set when button n is pressed
+   */
+  virtual uint16_t readButtons() = 0;
+};
@@ -0,0 +1,56 @@
+#include <Arduino.h>
+
+#include "button_io.h"
+#include "button_scanner.h"
+#pragma once
+
+// the Teensy 4.1 spreads its pins over 4 GPIO ports
+#define BUTTON_IO_MAX_PORTS 4
+
+/**
+ * Reads all buttons with one read of each GPIO port they are on, instead of a
+ * digitalRead per button
+ */
+class ButtonIOImpl : public ButtonIO {
+  volatile uint32_t* m_ports[BUTTON_IO_MAX_PORTS];
+  uint8_t m_portCount;
+
+  uint8_t m_buttonPort[BUTTON_SCANNER_MAX_BUTTONS];
+  uint32_t m_buttonBit[BUTTON_SCANNER_MAX_BUTTONS];
+  uint8_t m_buttonCount;
+
+ public:
+  ButtonIOImpl(const uint8_t* pins, uint8_t count)
+      : m_portCount(0), m_buttonCount(count) {
+    for (uint8_t button = 0; button < count; button++) {
+      volatile uint32_t* port = portInputRegister(pins[button]);
+
+      uint8_t portIndex = 0;
+      while (portIndex < m_portCount && m_ports[portIndex] != port) {
+        portIndex++;
+      }
+      if (portIndex == m_portCount) {
+        m_ports[m_portCount++] = port;
+      }
+
+      m_buttonPort[button] = portIndex;
+      m_buttonBit[button] = digitalPinToBitMask(pins[button]);
+    }
+  }
+
+  inline uint16_t readButtons() {
+    uint32_t ports[BUTTON_IO_MAX_PORTS];
+    for (uint8_t port = 0; port < m_portCount; port++) {
+      ports[port] = *m_ports[port];
+    }
+
+    // the buttons are pulled up, so a pressed button reads low
+    uint16_t pressed = 0;
+    for (uint8_t button = 0; button < m_buttonCount; button++) {
+      if (!(ports[m_buttonPort[button]] & m_buttonBit[button])) {
+        pressed |= 1 << button;
+      }
+    }
+    return pressed;
+  }
+};
@@ -0,0 +1,91 @@
+#include "button_scanner.h"
+
+#include <els_elapsedMillis.h>
+
+ButtonScanner::ButtonScanner(ButtonIO* io, uint32_t sampleMillis,
+                             uint32_t heldMillis, uint32_t clickMillis)
+    : m_io(io),
+      m_sampleMillis(sampleMillis),
+      m_heldMillis(heldMillis),
+      m_clickMillis(clickMillis),
+      m_lastSampleMillis(0),
+      m_state(0),
+      m_count0(0),
+      m_count1(0),
+      m_held(0),
+      m_pendingClick(0) {
+  for (int button = 0; button < BUTTON_SCANNER_MAX_BUTTONS; button++) {
+    m_pressedAt[button] = 0;
+    m_clickedAt[button] = 0;
+  }
+}
+
+uint16_t ButtonScanner::debounce(uint16_t sample) {
+  // the counters of buttons that read the same as their state are reset,
+  // the others count up and the state flips when they roll over
+  uint16_t delta = sample ^ m_state;
+  m_count1 = (m_count1 ^ m_count0) & delta;
+  m_count0 = ~m_count0 & delta;
+  uint16_t toggle = delta & ~(m_count0 | m_count1);
+  m_state ^= toggle;
+  return toggle;
+}
+
+ButtonEvents ButtonScanner::scan() {
+  ButtonEvents events = {};
+  uint32_t now = millis();
+
+  if (now - m_lastSampleMillis >= m_sampleMillis) {
+    m_lastSampleMillis = now;
+    uint16_t toggle = debounce(m_io->readButtons());
+
+    for (uint16_t bits = toggle; bits; bits &= bits - 1) {
+      int button = __builtin_ctz(bits);
+      uint16_t mask = 1 << button;
+
+      if (m_state & mask) {
+        m_pressedAt[button] = now;
+        continue;
+      }
+
+      // released, a short press is a click
+      bool wasHeld = m_held & mask;
+      m_held &= ~mask;
+      if (wasHeld || now - m_pressedAt[button] > m_clickMillis) {
+        continue;
+      }
+
+      events.clicked |= mask;
+      if ((m_pendingClick & mask) &&
+          now - m_clickedAt[button] <= m_clickMillis) {
+        events.doubleClicked |= mask;
+        m_pendingClick &= ~mask;
+      } else {
+        m_pendingClick |= mask;
+        m_clickedAt[button] = now;
+      }
+    }
+
+    // buttons held down long enough
+    for (uint16_t bits = m_state & ~m_held; bits; bits &= bits - 1) {
+      int button = __builtin_ctz(bits);
+      if (now - m_pressedAt[button] >= m_heldMillis) {
+        events.heldStarted |= 1 << button;
+      }
+    }
+    m_held |= events.heldStarted;
+
+    // clicks that weren't followed up by a second one in time
+    for (uint16_t bits = m_pendingClick & ~m_state; bits; bits &= bits - 1) {
+      int button = __builtin_ctz(bits);
+      if (now - m_clickedAt[button] > m_clickMillis) {
+        events.singleClicked |= 1 << button;
+      }
+    }
+    m_pendingClick &= ~events.singleClicked;
+  }
+
+  events.pressed = m_state;
+  events.held = m_held;
+  return events;
+}
@@ -0,0 +1,67 @@
+#include <cstdint>
+
+#include "button_io.h"
+#pragma once
+
+#define BUTTON_SCANNER_MAX_BUTTONS 16
+
+/**
+ * The events of all buttons for a single scan, bit n is for button n
+ */
+struct ButtonEvents {
+  // debounced state, set while the button is down
+  uint16_t pressed;
+  // set while the button has been down for longer than the held time
+  uint16_t held;
+  // set on the scan the button became held
+  uint16_t heldStarted;
+  // set on the scan a short press was released
+  uint16_t clicked;
+  // set once a click wasn't followed by a second one within the click time
+  uint16_t singleClicked;
+  // set on the scan the second of two quick clicks was released
+  uint16_t doubleClicked;
+};
+
+/**
+ * Debounces all buttons at once and turns them into click/hold events
+ *
+ * The buttons are sampled every sampleMillis and debounced with a 2 bit
+ * vertical counter per button, a button has to read the same for 4 samples in
+ * a row before its state changes. The cost and latency of a scan don't depend
+ * on how many buttons there are.
+ */
+class ButtonScanner {
+ private:
+  ButtonIO* m_io;
+
+  const uint32_t m_sampleMillis;
+  const uint32_t m_heldMillis;
+  const uint32_t m_clickMillis;
+
+  uint32_t m_lastSampleMillis;
+
+  // debounced state and the two bits of the vertical counters
+  uint16_t m_state;
+  uint16_t m_count0;
+  uint16_t m_count1;
+
+  uint16_t m_held;
+  // clicks waiting to find out if they're single or double clicks
+  uint16_t m_pendingClick;
+
+  uint32_t m_pressedAt[BUTTON_SCANNER_MAX_BUTTONS];
+  uint32_t m_clickedAt[BUTTON_SCANNER_MAX_BUTTONS];
+
+  // bits that changed in the debounced state
+  uint16_t debounce(uint16_t sample);
+
+ public:
+  ButtonScanner(ButtonIO* io, uint32_t sampleMillis, uint32_t heldMillis,
+                uint32_t clickMillis);
+
+  /**
+   * Sample the buttons if a sample is due and return the resulting events
+   */
+  ButtonEvents scan();
+};
@@ -0,0 +1,70 @@
+#include "clock.h"
+
+#include <config.h>
+
+#ifndef PIO_UNIT_TESTING
+#include <Arduino.h>
+
+// the high half of the extended cycle counter and the last low half we saw
+static volatile uint32_t cycleCountHigh = 0;
+static volatile uint32_t lastCycleCount = 0;
+
+// the reading of the last tick, in halves since the main loop can be
+// interrupted half way through reading it
+static volatile uint32_t tickMicrosHigh = 0;
+static volatile uint32_t tickMicrosLow = 0;
+
+// the Teensy core has no CMSIS PRIMASK accessors, 1 means interrupts are off
+static inline uint32_t getPrimask() {
+  uint32_t primask;
+  __asm__ volatile("mrs %0, primask" : "=r"(primask));
+  return primask;
+}
+
+static inline void setPrimask(uint32_t primask) {
+  __asm__ volatile("msr primask, %0" : : "r"(primask) : "memory");
+}
+
+uint64_t Clock::micros() {
+  // both the main loop and the timer read the clock, so the extension can't
+  // be interrupted half way through. Callers may already have interrupts off,
+  // so they are put back the way they were rather than turned on
+  uint32_t primask = getPrimask();
+  __disable_irq();
+  uint32_t cycles = ARM_DWT_CYCCNT;
+  if (cycles < lastCycleCount) {
+    cycleCountHigh = cycleCountHigh + 1;
+  }
+  lastCycleCount = cycles;
+  uint64_t extended = ((uint64_t)cycleCountHigh << 32) | cycles;
+  setPrimask(primask);
+
+  return extended / (F_CPU_ACTUAL / US_PER_SECOND);
+}
+
+uint64_t Clock::tick() {
+  // only the timer ticks, nothing writes these while it runs
+  uint64_t now = micros();
+  tickMicrosHigh = (uint32_t)(now >> 32);
+  tickMicrosLow = (uint32_t)now;
+  return now;
+}
+
+uint64_t Clock::tickMicros() {
+  // a tick between reading the halves changes the high half or leaves it
+  // matching the new low half, so read again only when it changed
+  uint32_t high;
+  uint32_t low;
+  do {
+    high = tickMicrosHigh;
+    low = tickMicrosLow;
+  } while (high != tickMicrosHigh);
+  return ((uint64_t)high << 32) | low;
+}
+#else
+uint64_t Clock::micros() { return MicrosSingleton::getInstance().micros64(); }
+
+uint64_t Clock::tick() { return micros(); }
+
+uint64_t Clock::tickMicros() { return micros(); }
+#endif
@@ -0,0 +1,61 @@
+#include <els_elapsedMillis.h>
+
+#include <cstdint>
+
+#pragma once
+
+/**
+ * A 64 bit monotonic microsecond clock
+ *
+ * micros() is 32 bits and wraps about every 71 minutes, which is a lot shorter
+ * than a shift on the machine. This extends the CPU cycle counter instead, so
+ * timestamps from this clock never wrap while the machine is running.
+ *
+ * The cycle counter itself wraps every few seconds, the extension only works
+ * as long as the clock is read at least that often (the leadscrew timer reads
+ * it every tick)
+ */
+class Clock {
+ public:
+  static uint64_t micros();
+
+  /**
+   * Read the clock for the timer tick that is starting, the axes stepped in
+   * the tick all go by this reading through tickMicros()
+   */
+  static uint64_t tick();
+
+  /**
+   * The clock as of the last tick(), without the cost of reading it again. In
+   * the tests there are no ticks, it is the test clock itself
+   */
+  static uint64_t tickMicros();
+};
+
+/**
+ * elapsedMicros on top of Clock, it doesn't give up after 71 minutes
+ *
+ * It goes by the timer tick rather than the clock itself, the axes check
+ * several of these every tick. From the main loop it is up to a tick behind
+ */
+class elapsedMicros64 {
+ private:
+  uint64_t us;
+
+ public:
+  elapsedMicros64(void) { us = Clock::tickMicros(); }
+  elapsedMicros64(uint64_t val) { us = Clock::tickMicros() - val; }
+  operator uint64_t() const { return Clock::tickMicros() - us; }
+  elapsedMicros64 &operator=(uint64_t val) {
+    us = Clock::tickMicros() - val;
+    return *this;
+  }
+  elapsedMicros64 &operator-=(uint64_t val) {
+    us += val;
+    return *this;
+  }
+  elapsedMicros64 &operator+=(uint64_t val) {
+    us -= val;
+    return *this;
+  }
+};
@@ -37,16 +37,38 @@
 #define ELS_LEADSCREW_STEP 2
 #define ELS_LEADSCREW_DIR 3
 
+/**
+ * Manual pulse generator (handwheel) for jogging, uncomment these if you have
+ * one attached
+ */
+// #define ELS_MPG_ENCODER_A 16
+// #define ELS_MPG_ENCODER_B 17
+
 #define ELS_RATE_INCREASE_BUTTON 4
 #define ELS_RATE_DECREASE_BUTTON 5
 #define ELS_MODE_CYCLE_BUTTON 6
 #define ELS_THREAD_SYNC_BUTTON 7
+// with a handwheel attached a click of the half nut button cycles through
+// the handwheel multipliers (see mpgMultipliers) instead
 #define ELS_HALF_NUT_BUTTON 8
 #define ELS_ENABLE_BUTTON 9
 #define ELS_LOCK_BUTTON 10
 #define ELS_JOG_LEFT_BUTTON 24
 #define ELS_JOG_RIGHT_BUTTON 25
 
+/**
+ * Buttons
+ *
+ * All buttons are sampled together every ELS_BUTTON_SAMPLE_MS and have to read
+ * the same for 4 samples in a row to register, which debounces them.
+ * A press released within ELS_BUTTON_CLICK_MS is a click, two clicks within
+ * ELS_BUTTON_CLICK_MS of each other are a double click. A press longer than
+ * ELS_BUTTON_HELD_MS is a hold.
+ */
+#define ELS_BUTTON_SAMPLE_MS 5
+#define ELS_BUTTON_CLICK_MS 500
+#define ELS_BUTTON_HELD_MS 1000
+
 /**
  * Display
  *
@@ -63,20 +85,99 @@
 #define PIN_DISPLAY_RESET -1
 #endif
 
+/**
+ * Display refresh
+ *
+ * The display is only redrawn when something on it changed, and never faster
+ * than ELS_DISPLAY_MAX_FPS. The mode, pitch and status icons are redrawn as
+ * soon as they change, the spindle RPM is sampled every
+ * ELS_DISPLAY_RPM_REFRESH_MS.
+ *
+ * Sending a frame is split over multiple calls, at most
+ * ELS_DISPLAY_PAGES_PER_UPDATE pages (128x8 pixels) are sent each loop so the
+ * buttons are never starved by the display
+ */
+#define ELS_DISPLAY_MAX_FPS 30
+#define ELS_DISPLAY_RPM_REFRESH_MS 100
+#define ELS_DISPLAY_PAGES_PER_UPDATE 2
+
 #define ELS_SPINDLE_ENCODER_PPR 400
+
+/**
+ * Low resolution spindle sensors, e.g a hall sensor or an encoder with a
+ * handful of pulses per revolution. Set ELS_SPINDLE_ENCODER_PPR to the
+ * sensor's pulses and this to how many counts each pulse is split into, the
+ * counts are timed from the period of the previous pulses. 1 uses the pulses
+ * as they are, which is what a high resolution encoder wants
+ */
+#define ELS_SPINDLE_INTERPOLATION 1
+
+// the spindle counts per revolution the leadscrew is geared from
+#define ELS_SPINDLE_COUNTS_PER_REV \
+  (ELS_SPINDLE_ENCODER_PPR * ELS_SPINDLE_INTERPOLATION)
+// the fastest the spindle is run while feeding and while threading, the build
+// fails if the leadscrew can't keep up with the coarsest pitch at these speeds
+// (see config_checks.h)
+#define ELS_FEED_MAX_RPM 3000
+#define ELS_THREAD_MAX_RPM 600
 #define ELS_LEADSCREW_STEPPER_PPR 400
 #define ELS_LEADSCREW_PITCH_MM 1.25
 
+// the slack in the leadscrew and half nut in mm, the motor turns this much
+// further on every reversal before the carriage moves. Measure it with a dial
+// indicator and leave it at 0 if the screw has none
+#define ELS_LEADSCREW_BACKLASH_MM 0
+
 #define ELS_LEADSCREW_STEPS_PER_MM \
   (float)(ELS_LEADSCREW_STEPPER_PPR / ELS_LEADSCREW_PITCH_MM)
 
+/**
+ * Closed loop leadscrew, uncomment ELS_LEADSCREW_FEEDBACK_A if a linear scale
+ * on the carriage or an encoder on the leadscrew reads back where the carriage
+ * really is. It is compared against the steps sent every timer tick, steps lost
+ * beyond the deadband are made up by the ramp and past the fault distance the
+ * leadscrew is disabled.
+ *
+ * An encoder on the leadscrew can't see the backlash, the take up steps look
+ * like lost steps to it, so use a linear scale if the backlash is compensated
+ */
+// #define ELS_LEADSCREW_FEEDBACK_A 30
+// #define ELS_LEADSCREW_FEEDBACK_B 31
+// quadrature counts per mm of travel, 200 for a 5um scale
+#define ELS_LEADSCREW_FEEDBACK_COUNTS_PER_MM 200
+#define ELS_LEADSCREW_FEEDBACK_DEADBAND_MM 0.01
+#define ELS_LEADSCREW_FEEDBACK_FAULT_MM 0.5
+
+/**
+ * Motorised cross slide, uncomment ELS_CROSS_SLIDE_STEP and ELS_CROSS_SLIDE_DIR
+ * if yours is. It is stepped by the same timer as the leadscrew and ramps with
+ * the same jerk and acceleration
+ */
+// #define ELS_CROSS_SLIDE_STEP 28
+// #define ELS_CROSS_SLIDE_DIR 29
+#define ELS_CROSS_SLIDE_STEPPER_PPR 400
+#define ELS_CROSS_SLIDE_PITCH_MM 1
+
+#define ELS_CROSS_SLIDE_STEPS_PER_MM \
+  (float)(ELS_CROSS_SLIDE_STEPPER_PPR / ELS_CROSS_SLIDE_PITCH_MM)
+
 // extra config options
-// jog speed in mm/s
-#define JOG_SPEED 100
+// raw quadrature counts per click of the handwheel
+#define ELS_MPG_COUNTS_PER_DETENT 4
+// the most the leadscrew may lag behind the handwheel in mm, anything beyond
+// this is dropped so spinning the wheel fast can't run away with the carriage
+#define ELS_MPG_MAX_BACKLOG_MM 1
 
-#define JOG_PULSE_DELAY   \
-  ((float)US_PER_SECOND / \
-   ((float)JOG_SPEED * (float)ELS_LEADSCREW_STEPS_PER_MM))
+// rapid jog speed in mm/s, at most LEADSCREW_MAX_STEP_RATE steps per second
+#define JOG_SPEED 75
+// a click of a jog button moves by this many mm
+#define JOG_FINE_STEP_MM 0.01
+// holding a jog button starts at the first speed (mm/s) and steps up a tier
+// every JOG_TIER_MS it is held, up to rapid
+#define JOG_TIER_MS 1000
+// how quickly the jog speed ramps up and down in mm/s^2, jogging is executed
+// by the leadscrew timer so this is independent of the main loop
+#define JOG_ACCEL LEADSCREW_ACCEL
 
 /**
  * The unit mode the system should start up in
@@ -87,6 +188,10 @@
 #define DEFAULT_UNIT_MODE GlobalUnitMode::METRIC
 #define DEFAULT_FEED_MODE GlobalFeedMode::FEED
 
+// the mode, pitch and stops are saved once they have been left alone for this
+// long and restored on the next boot
+#define ELS_SESSION_SAVE_DELAY_MS 2000
+
 // The default starting speed for leadscrew in mm/s
 // this is the maximum allowable speed (in mm/s) for the leadscrew to
 // instantaneously start moving from 0
@@ -98,6 +203,32 @@
 
 #define LEADSCREW_TIMER_US 20
 
+/**
+ * The longest the timer waits between ticks. It runs every LEADSCREW_TIMER_US
+ * while an axis follows the spindle or a jog, otherwise it waits for the next
+ * step edge, and while everything is in position and the spindle stands still
+ * it is parked at this period, only picking up the encoders and the main loop.
+ * The encoders still count on their pin interrupts, so nothing is lost, the
+ * leadscrew just starts following up to this late. A spindle starting from
+ * standstill takes milliseconds to its first counts
+ */
+#define ELS_IDLE_TIMER_US 250
+
+// how long the stepper drivers need between a change of the direction pin and
+// the next step edge, see the driver's datasheet. A reversal changes the pin
+// in its own timer tick right after the last step the old way, so this only
+// holds the step up if it is longer than the pulse delay at the jerk speed
+#define ELS_STEPPER_DIR_SETUP_US 5
+
+// the spindle's speed is measured over at least this long to tell it slowing
+// down to reverse apart from the jitter of single encoder pulses. While it is
+// slowing down the leadscrew ramps down to stop where the spindle will turn
+#define ELS_SPINDLE_DECEL_WINDOW_US 10000
+
+// a step pulse is high for one timer tick and low for the next, so this is the
+// fastest the leadscrew can ever be stepped
+#define LEADSCREW_MAX_STEP_RATE (US_PER_SECOND / (2 * LEADSCREW_TIMER_US))
+
 // The initial delay between pulses in microseconds for the leadscrew starting
 // from 0 do not change - this is a calculated value, to change the initial
 // speed look at the jerk value
@@ -118,27 +249,47 @@
   ((float)LEADSCREW_ACCEL / ((float)ELS_LEADSCREW_STEPS_PER_MM))
 #endif
 
+// the same for the cross slide
+#ifdef ACCEL_DISABLED
+#define CROSS_SLIDE_INITIAL_PULSE_DELAY_US 0
+#define CROSS_SLIDE_PULSE_DELAY_STEP_US 0
+#else
+#define CROSS_SLIDE_INITIAL_PULSE_DELAY_US \
+  ((float)US_PER_SECOND /                  \
+   ((float)LEADSCREW_JERK * (float)ELS_CROSS_SLIDE_STEPS_PER_MM))
+#define CROSS_SLIDE_PULSE_DELAY_STEP_US \
+  ((float)LEADSCREW_ACCEL / ((float)ELS_CROSS_SLIDE_STEPS_PER_MM))
+#endif
+
 // metric thread pitch is defined as mm/rev
-const float threadPitchMetric[] = {0.35, 0.40, 0.45, 0.50, 0.60, 0.70, 0.80,
-                                   1.00, 1.25, 1.50, 1.75, 2.00, 2.50, 3.00,
-                                   3.50, 4.00, 4.50, 5.00, 5.50, 6.00};
+constexpr float threadPitchMetric[] = {0.35, 0.40, 0.45, 0.50, 0.60, 0.70,
+                                       0.80, 1.00, 1.25, 1.50, 1.75, 2.00,
+                                       2.50, 3.00, 3.50, 4.00, 4.50, 5.00,
+                                       5.50, 6.00};
 #define DEFAULT_METRIC_THREAD_PITCH_IDX 8
 
 // defined as mm/rev
-const float feedPitchMetric[] = {0.05, 0.08, 0.10, 0.12, 0.15, 0.18, 0.20,
-                                 0.23, 0.25, 0.28, 0.30, 0.35, 0.40, 0.45,
-                                 0.50, 0.55, 0.60, 0.65, 0.70, 0.75};
+constexpr float feedPitchMetric[] = {0.05, 0.08, 0.10, 0.12, 0.15, 0.18, 0.20,
+                                     0.23, 0.25, 0.28, 0.30, 0.35, 0.40, 0.45,
+                                     0.50, 0.55, 0.60, 0.65, 0.70, 0.75};
 #define DEFAULT_METRIC_FEED_PITCH_IDX 8
 
 // for convenience these are defined as TPI - retained as float to allow for
 // partial TPI for whatever reason
-const float threadPitchImperial[] = {80, 72, 64, 56, 48, 44, 40, 36, 32, 28,
-                                     24, 20, 18, 16, 14, 13, 12, 11, 10, 9};
+constexpr float threadPitchImperial[] = {80, 72, 64, 56, 48, 44, 40,
+                                         36, 32, 28, 24, 20, 18, 16,
+                                         14, 13, 12, 11, 10, 9};
 #define DEFAULT_IMPERIAL_THREAD_PITCH_IDX 8
 // defined as thou/rev
-const float feedPitchImperial[] = {
+constexpr float feedPitchImperial[] = {
     0.002, 0.003, 0.004, 0.005, 0.006, 0.007, 0.008, 0.009, 0.010, 0.011,
     0.012, 0.014, 0.016, 0.018, 0.020, 0.022, 0.024, 0.026, 0.028, 0.030};
 #define DEFAULT_IMPERIAL_FEED_PITCH_IDX 8
 
+// jog speed tiers in mm/s, see JOG_TIER_MS
+constexpr float jogSpeedTiers[] = {0.5, 2, 10, 30, JOG_SPEED};
+
+// leadscrew steps per handwheel detent, cycled with the half nut button
+const int mpgMultipliers[] = {1, 10, 100};
+
 #endif
\ No newline at end of file
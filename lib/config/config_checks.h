@@ -0,0 +1,138 @@
+// Compile time checks that the machine described in config.h can actually
+// keep up with what it is asked to do. The machine profile runs the same
+// checks at runtime
+
+#include "config.h"
+
+#pragma once
+
+namespace ConfigChecks {
+
+constexpr float maxOf(const float* values, unsigned int count) {
+  float result = values[0];
+  for (unsigned int i = 1; i < count; i++) {
+    if (values[i] > result) {
+      result = values[i];
+    }
+  }
+  return result;
+}
+
+constexpr float minOf(const float* values, unsigned int count) {
+  float result = values[0];
+  for (unsigned int i = 1; i < count; i++) {
+    if (values[i] < result) {
+      result = values[i];
+    }
+  }
+  return result;
+}
+
+// the coarsest pitch in each mode, in mm/rev
+constexpr float maxThreadPitchMm() {
+  float metric = maxOf(threadPitchMetric, ARRAY_SIZE(threadPitchMetric));
+  // imperial threads are in TPI, the coarsest has the fewest threads
+  float imperial =
+      25.4 / minOf(threadPitchImperial, ARRAY_SIZE(threadPitchImperial));
+  return metric > imperial ? metric : imperial;
+}
+
+constexpr float maxFeedPitchMm() {
+  float metric = maxOf(feedPitchMetric, ARRAY_SIZE(feedPitchMetric));
+  // imperial feeds are in inches/rev
+  float imperial =
+      25.4 * maxOf(feedPitchImperial, ARRAY_SIZE(feedPitchImperial));
+  return metric > imperial ? metric : imperial;
+}
+
+// leadscrew steps per second needed to follow the spindle
+constexpr float stepRateFor(float mmPerRevolution, float rpm,
+                            float stepsPerMm) {
+  return mmPerRevolution * (rpm / 60) * stepsPerMm;
+}
+
+// spindle encoder counts per leadscrew timer tick
+constexpr float spindleCountsPerTick(float rpm, float pulsesPerRevolution) {
+  return (rpm / 60) * pulsesPerRevolution * LEADSCREW_TIMER_US /
+         US_PER_SECOND;
+}
+
+static_assert(stepRateFor(maxFeedPitchMm(), ELS_FEED_MAX_RPM,
+                          ELS_LEADSCREW_STEPS_PER_MM) <=
+                  LEADSCREW_MAX_STEP_RATE,
+              "The coarsest feed at ELS_FEED_MAX_RPM needs more steps per "
+              "second than the leadscrew timer can produce, lower "
+              "ELS_FEED_MAX_RPM or the feed table or raise "
+              "LEADSCREW_MAX_STEP_RATE (shorter LEADSCREW_TIMER_US)");
+
+static_assert(stepRateFor(maxThreadPitchMm(), ELS_THREAD_MAX_RPM,
+                          ELS_LEADSCREW_STEPS_PER_MM) <=
+                  LEADSCREW_MAX_STEP_RATE,
+              "The coarsest thread at ELS_THREAD_MAX_RPM needs more steps per "
+              "second than the leadscrew timer can produce, lower "
+              "ELS_THREAD_MAX_RPM or the thread tables or raise "
+              "LEADSCREW_MAX_STEP_RATE (shorter LEADSCREW_TIMER_US)");
+
+// the timer picks up spindle counts every tick, more than a revolution
+// between two ticks would make the direction ambiguous
+static_assert(ELS_SPINDLE_INTERPOLATION >= 1,
+              "ELS_SPINDLE_INTERPOLATION must be at least 1");
+
+static_assert(spindleCountsPerTick(ELS_FEED_MAX_RPM,
+                                   ELS_SPINDLE_COUNTS_PER_REV) <
+                  ELS_SPINDLE_COUNTS_PER_REV,
+              "The spindle turns more than a revolution per leadscrew timer "
+              "tick at ELS_FEED_MAX_RPM");
+
+static_assert(JOG_SPEED * ELS_LEADSCREW_STEPS_PER_MM <= LEADSCREW_MAX_STEP_RATE,
+              "JOG_SPEED needs more steps per second than the leadscrew timer "
+              "can produce");
+
+static_assert(ELS_FEED_MAX_RPM >= ELS_THREAD_MAX_RPM,
+              "ELS_THREAD_MAX_RPM should not be above ELS_FEED_MAX_RPM");
+
+#ifdef ELS_CROSS_SLIDE_STEP
+// a taper follows the carriage step for step, at most 1:1
+static_assert(stepRateFor(maxFeedPitchMm(), ELS_FEED_MAX_RPM,
+                          ELS_CROSS_SLIDE_STEPS_PER_MM) <=
+                  LEADSCREW_MAX_STEP_RATE,
+              "A 1:1 taper at the coarsest feed and ELS_FEED_MAX_RPM needs "
+              "more cross slide steps per second than the leadscrew timer can "
+              "produce");
+
+static_assert(stepRateFor(maxThreadPitchMm(), ELS_THREAD_MAX_RPM,
+                          ELS_CROSS_SLIDE_STEPS_PER_MM) <=
+                  LEADSCREW_MAX_STEP_RATE,
+              "A 1:1 taper at the coarsest thread and ELS_THREAD_MAX_RPM needs "
+              "more cross slide steps per second than the leadscrew timer can "
+              "produce");
+#endif
+
+#ifndef ACCEL_DISABLED
+// a step pulse is high for a tick and low for a tick, the ramp starts with
+// one pulse per initial delay so it has to be at least that long
+static_assert(LEADSCREW_INITIAL_PULSE_DELAY_US >= 2 * LEADSCREW_TIMER_US,
+              "LEADSCREW_JERK is faster than the leadscrew timer can step, "
+              "lower it or shorten LEADSCREW_TIMER_US");
+
+// every pulse changes the delay by this fraction of the pulse's duration, at
+// 1 or more the first pulse would already jump to full speed
+static_assert(LEADSCREW_PULSE_DELAY_STEP_US < 1,
+              "LEADSCREW_ACCEL is too high for ELS_LEADSCREW_STEPS_PER_MM, the "
+              "ramp would go from standstill to full speed in one step");
+
+static_assert(LEADSCREW_PULSE_DELAY_STEP_US > 0,
+              "LEADSCREW_ACCEL must be above 0, define ACCEL_DISABLED to "
+              "turn the ramp off");
+
+#ifdef ELS_CROSS_SLIDE_STEP
+static_assert(CROSS_SLIDE_INITIAL_PULSE_DELAY_US >= 2 * LEADSCREW_TIMER_US,
+              "LEADSCREW_JERK is faster than the leadscrew timer can step the "
+              "cross slide, lower it or shorten LEADSCREW_TIMER_US");
+
+static_assert(CROSS_SLIDE_PULSE_DELAY_STEP_US < 1,
+              "LEADSCREW_ACCEL is too high for ELS_CROSS_SLIDE_STEPS_PER_MM");
+#endif
+#endif
+
+}  // namespace ConfigChecks
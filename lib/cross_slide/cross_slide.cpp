@@ -0,0 +1,176 @@
+#include "cross_slide.h"
+
+#include <cmath>
+
+#ifndef PIO_UNIT_TESTING
+#include <Arduino.h>
+#endif
+
+CrossSlide::CrossSlide(StepperIO* io, StepperAxis* source,
+                       float initialPulseDelay, float pulseDelayIncrement,
+                       int motorPulsePerRevolution, float pitch)
+    : StepperAxis(io, initialPulseDelay, pulseDelayIncrement,
+                  motorPulsePerRevolution, pitch),
+      m_source(source),
+      m_target(0),
+      m_targetChanged(false),
+      m_configChanged(false),
+      m_taperRatioNm(0),
+      m_sourcePitchNm(0),
+      m_sourcePulsePerRevolution(0),
+      m_locked(false) {
+  m_pendingConfig.mode = GlobalMotionMode::DISABLED;
+  m_pendingConfig.taperRatio = 0;
+  m_pendingConfig.taperRatioNm = 0;
+  m_config = m_pendingConfig;
+  publishConfig();
+
+  m_gearbox.rebase(0, 0);
+  m_gearbox.numerator = 0;
+  m_gearbox.denominator = 1;
+}
+
+void CrossSlide::publishConfig() {
+  m_publishedConfig.write(m_pendingConfig);
+  m_configChanged = true;
+}
+
+void CrossSlide::readConfig() {
+  // as for the leadscrew, a publish we interrupted is picked up next time
+  m_configChanged = false;
+  m_publishedConfig.tryRead(m_config);
+}
+
+void CrossSlide::moveTo(int64_t position) {
+  m_target.write(position);
+  m_targetChanged = true;
+}
+
+void CrossSlide::setMotionMode(GlobalMotionMode mode) {
+  if (m_pendingConfig.mode == mode) {
+    return;
+  }
+  m_pendingConfig.mode = mode;
+  publishConfig();
+}
+
+void CrossSlide::setRatio(float ratio) {
+  if (ratio == m_pendingConfig.taperRatio) {
+    return;
+  }
+  m_pendingConfig.taperRatio = ratio;
+  m_pendingConfig.taperRatioNm = llround(ratio * NM_PER_MM);
+  publishConfig();
+}
+
+float CrossSlide::getRatio() { return m_pendingConfig.taperRatio; }
+
+bool CrossSlide::isFollowing() {
+  // the carriage ramps down and back up on a feed hold, the taper follows it
+  bool engaged = m_config.mode == GlobalMotionMode::ENABLED ||
+                 m_config.mode == GlobalMotionMode::HOLD;
+  return m_source != nullptr && engaged && m_config.taperRatioNm != 0;
+}
+
+void CrossSlide::update() {
+  readConfig();
+  int64_t sourceSteps = m_source != nullptr ? m_source->getCurrentPosition() : 0;
+
+  if (!isFollowing()) {
+    // the carriage moving doesn't move the cross slide
+    m_gearbox.rebase(sourceSteps, m_expectedPosition);
+  }
+
+  // cleared before the read, so a move that is published while we read is
+  // picked up on the next tick
+  if (m_targetChanged) {
+    m_targetChanged = false;
+    int64_t target;
+    if (m_target.tryRead(target)) {
+      m_gearbox.rebase(sourceSteps, target);
+    } else {
+      m_targetChanged = true;
+    }
+  }
+
+  // a new taper, or a new pitch or stepper on the source from the machine
+  // profile, carries on from where the old gearing left the cross slide
+  if (m_source != nullptr) {
+    const MotionConstants& source = m_source->getMotionConstants();
+    if (m_config.taperRatioNm != m_taperRatioNm ||
+        source.leadscrewPitchNm != m_sourcePitchNm ||
+        source.motorPulsePerRevolution != m_sourcePulsePerRevolution) {
+      m_gearbox.rebase(sourceSteps, m_gearbox.output(sourceSteps));
+      // source steps to nm of carriage travel, times nm of cross slide per mm
+      // of carriage travel. Both are around 10^6 so this is good for a few
+      // million steps of carriage travel per move
+      m_gearbox.numerator = source.leadscrewPitchNm * m_config.taperRatioNm;
+      m_gearbox.denominator =
+          (int64_t)source.motorPulsePerRevolution * NM_PER_MM;
+      m_taperRatioNm = m_config.taperRatioNm;
+      m_sourcePitchNm = source.leadscrewPitchNm;
+      m_sourcePulsePerRevolution = source.motorPulsePerRevolution;
+    }
+  }
+  m_expectedPosition = m_gearbox.output(sourceSteps);
+
+  // the source is already ramped, a taper is at most 1:1 with the same
+  // acceleration and the source is held back if the cross slide needs more
+  // steps than it. So once it has caught up with the carriage the cross slide
+  // steps as soon as a step is due, a ramp of its own would only fall behind.
+  // Until then, say following starts during a move of its own, it ramps as
+  // usual, and moves of its own start from standstill again
+  bool following = isFollowing();
+  if (!following) {
+    if (m_locked) {
+      m_currentPulseDelay = m_constants.initialPulseDelay;
+    }
+    m_locked = false;
+  } else if (getPositionError() == 0) {
+    m_locked = true;
+  }
+  if (m_locked) {
+    m_currentPulseDelay = 0;
+  }
+  if (m_source != nullptr) {
+    m_source->setMinPulseDelay(following ? getSourceMinPulseDelay() : 0);
+  }
+
+  stepTowardsExpectedPosition(INT64_MIN, INT64_MAX);
+}
+
+float CrossSlide::getSourceMinPulseDelay() {
+  // a step takes two ticks, so with more steps than the source the source has
+  // to slow down for them. Only its catching up goes this fast, see the step
+  // rate checks in config_checks.h
+  float stepsPerSourceStep =
+      fabsf((float)m_gearbox.numerator / m_gearbox.denominator) *
+      m_constants.motorPulsePerRevolution / m_constants.leadscrewPitchNm;
+  if (stepsPerSourceStep <= 1) {
+    return 0;
+  }
+  return stepsPerSourceStep * 2 * LEADSCREW_TIMER_US;
+}
+
+uint64_t CrossSlide::getNextUpdateMicros() {
+  // a mode or taper change can start it following
+  if (m_configChanged || m_targetChanged || isFollowing()) {
+    return 0;
+  }
+  // the update after the last step is what settles the direction
+  if (getPositionError() == 0) {
+    return m_currentDirection == LeadscrewDirection::UNKNOWN ? UINT64_MAX : 0;
+  }
+  return getNextEdgeMicros();
+}
+
+void CrossSlide::printState() {
+#ifndef PIO_UNIT_TESTING
+  Serial.print("Cross slide position nm: ");
+  Serial.println(getCurrentPositionNm());
+  Serial.print("Cross slide expected position nm: ");
+  Serial.println(getExpectedPositionNm());
+  Serial.print("Cross slide taper ratio: ");
+  Serial.println(getRatio());
+#endif
+}
@@ -0,0 +1,85 @@
+#include <gearbox.h>
+#include <globalstate.h>
+#include <seqlock.h>
+#include <stepper_axis.h>
+
+#include <cstdint>
+
+#pragma once
+
+/**
+ * Everything the timer needs from the main loop for the cross slide
+ */
+struct CrossSlideConfig {
+  GlobalMotionMode mode;
+  // cross slide mm per mm of carriage travel, 0 when not tapering
+  float taperRatio;
+  // the same in nm per mm
+  int64_t taperRatioNm;
+};
+
+/**
+ * The motorised cross slide, it is moved to positions the main loop asks for
+ * and is otherwise left where it is.
+ *
+ * With a taper ratio set it also follows the carriage while the leadscrew is
+ * enabled, geared off the leadscrew's actual step count so the taper is
+ * exact over the whole length. It has to be added to the StepScheduler after
+ * the leadscrew, so it sees the leadscrew's step from the same tick
+ */
+class CrossSlide : public StepperAxis, public DerivedAxis {
+ private:
+  // the axis the taper is geared off, usually the leadscrew
+  StepperAxis* m_source;
+
+  // the position the main loop asked for in nm
+  SeqLock<int64_t> m_target;
+  volatile bool m_targetChanged;
+
+  CrossSlideConfig m_pendingConfig;
+  SeqLock<CrossSlideConfig> m_publishedConfig;
+  CrossSlideConfig m_config;
+  void publishConfig();
+  // pick up the latest published config, call once at the start of update()
+  void readConfig();
+  // set by the main loop whenever it publishes, so an idle cross slide wakes
+  volatile bool m_configChanged;
+
+  // source steps in, nm out
+  Gearbox m_gearbox;
+  int64_t m_taperRatioNm;
+  // the source's MotionConstants the gearbox was worked out for
+  int64_t m_sourcePitchNm;
+  int m_sourcePulsePerRevolution;
+  // following and caught up with the source, see update()
+  bool m_locked;
+
+  bool isFollowing();
+  // the fastest the source may step while it is followed
+  float getSourceMinPulseDelay();
+
+ public:
+  // source may be null if nothing is tapered off
+  CrossSlide(StepperIO* io, StepperAxis* source, float initialPulseDelay,
+             float pulseDelayIncrement, int motorPulsePerRevolution,
+             float pitch);
+
+  // move to a position in nm, the move is ramped by the timer
+  void moveTo(int64_t position);
+
+  // the cross slide only follows the carriage while this is ENABLED or HOLD
+  void setMotionMode(GlobalMotionMode mode);
+  /**
+   * The taper as cross slide mm per mm of carriage travel, negative tapers
+   * the other way and 0 turns it off
+   */
+  void setRatio(float ratio) override;
+  float getRatio() override;
+
+  void update() override;
+  // every tick while following, the next step edge while it moves to a
+  // target, otherwise idle once it is in position until it is told to move
+  uint64_t getNextUpdateMicros() override;
+
+  void printState();
+};
@@ -0,0 +1,46 @@
+#include "isr_stats.h"
+
+#include <config.h>
+
+#ifndef PIO_UNIT_TESTING
+#include <Arduino.h>
+#define CYCLES_PER_MICROSECOND (F_CPU_ACTUAL / US_PER_SECOND)
+#else
+#define __disable_irq()
+#define __enable_irq()
+#define CYCLES_PER_MICROSECOND 1
+#endif
+
+IsrStats::IsrStats()
+    : m_busyCycles(0),
+      m_calls(0),
+      m_worstCycles(0),
+      m_loadPercent(0),
+      m_worstMicros(0) {}
+
+void IsrStats::sample() {
+  __disable_irq();
+  uint32_t busyCycles = m_busyCycles;
+  uint32_t calls = m_calls;
+  uint32_t worstCycles = m_worstCycles;
+  m_busyCycles = 0;
+  m_calls = 0;
+  m_worstCycles = 0;
+  __enable_irq();
+  uint32_t windowMicros = m_window;
+  m_window = 0;
+
+  if (calls == 0 || windowMicros == 0) {
+    m_loadPercent = 0;
+    m_worstMicros = 0;
+    return;
+  }
+
+  float windowCycles = (float)windowMicros * (float)CYCLES_PER_MICROSECOND;
+  m_loadPercent = busyCycles * 100.0 / windowCycles;
+  m_worstMicros = (float)worstCycles / CYCLES_PER_MICROSECOND;
+}
+
+float IsrStats::getLoadPercent() { return m_loadPercent; }
+
+float IsrStats::getWorstMicros() { return m_worstMicros; }
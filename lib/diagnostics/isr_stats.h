@@ -0,0 +1,50 @@
+#include <els_elapsedMillis.h>
+
+#include <cstdint>
+
+#pragma once
+
+/**
+ * Timing statistics for the motion timer callback
+ *
+ * The callback records how many CPU cycles each call took, the main loop
+ * periodically samples the totals to get the load and the worst case of the
+ * last window
+ */
+class IsrStats {
+ private:
+  // the timer slows down while it is parked, so the window is timed rather
+  // than worked out from the number of calls
+  elapsedMicros m_window;
+
+  volatile uint32_t m_busyCycles;
+  volatile uint32_t m_calls;
+  volatile uint32_t m_worstCycles;
+
+  float m_loadPercent;
+  float m_worstMicros;
+
+ public:
+  IsrStats();
+
+  // called from the timer callback with the cycles it took
+  inline void record(uint32_t cycles) {
+    m_busyCycles += cycles;
+    m_calls++;
+    if (cycles > m_worstCycles) {
+      m_worstCycles = cycles;
+    }
+  }
+
+  /**
+   * Close the current measurement window and start a new one, should be
+   * called from the main loop at least every few seconds so the cycle
+   * counters don't overflow
+   */
+  void sample();
+
+  // percentage of the timer period spent in the callback over the last window
+  float getLoadPercent();
+  // the longest single callback over the last window
+  float getWorstMicros();
+};
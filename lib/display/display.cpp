@@ -10,36 +10,139 @@
 #include <icons/threadSymbol.h>
 #include <icons/unlockedSymbol.h>
 
-void Display::init() {
+bool Display::init() {
 #if ELS_DISPLAY == SSD1306_128_64
   if (!this->m_ssd1306.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
     Serial.println(F("SSD1306 allocation failed"));
-    for (;;);
+    return false;
   }
   m_ssd1306.clearDisplay();
+  m_pitchLabels.init();
 #endif
+  m_initialised = true;
+  return true;
 }
 
+// the window the render load is averaged over
+#define DISPLAY_LOAD_WINDOW_US US_PER_SECOND
+
 void Display::update() {
+  // the display is brought up from the loop rather than at boot so a slow or
+  // missing display never holds up the motion
+  if (!m_initialised) {
+    if (m_initTimer < DISPLAY_INIT_RETRY_MS) {
+      return;
+    }
+    m_initTimer = 0;
+    if (!init()) {
+      return;
+    }
+  }
+
+  elapsedMicros updateTime;
+
+#if ELS_DISPLAY == SSD1306_128_64
+  // finish sending the previous frame before drawing a new one, only the
+  // pages that changed since the last frame are sent
+  if (!m_ssd1306.flush(ELS_DISPLAY_PAGES_PER_UPDATE)) {
+    accountUpdateTime(updateTime);
+    return;
+  }
+#endif
+
+  if (m_frameTimer < US_PER_SECOND / ELS_DISPLAY_MAX_FPS) {
+    accountUpdateTime(updateTime);
+    return;
+  }
+
+  DisplayState state = captureState();
+
+  // the rpm jitters constantly, only let it trigger a redraw periodically
+  bool periodicRefresh = !m_shownStateValid ||
+                         m_rpmTimer >= ELS_DISPLAY_RPM_REFRESH_MS;
+  if (periodicRefresh) {
+    m_rpmTimer = 0;
+  } else {
+    state.rpm = m_shownState.rpm;
+  }
+
+  // everything on the diagnostics page is live, refresh it with the rpm
+  bool diagnosticsRefresh =
+      state.page == GlobalDisplayPage::DIAGNOSTICS && periodicRefresh;
+
+  if (m_shownStateValid && state == m_shownState && !diagnosticsRefresh) {
+    accountUpdateTime(updateTime);
+    return;
+  }
+
+  m_shownState = state;
+  m_shownStateValid = true;
+  m_frameTimer = 0;
+  render();
+
+#if ELS_DISPLAY == SSD1306_128_64
+  m_ssd1306.flush(ELS_DISPLAY_PAGES_PER_UPDATE);
+#endif
+
+  accountUpdateTime(updateTime);
+}
+
+DisplayState Display::captureState() {
+  GlobalState *state = GlobalState::getInstance();
+  DisplayState displayState;
+  displayState.rpm = m_spindle->getEstimatedVelocityInRPM();
+  displayState.feedMode = state->getFeedMode();
+  displayState.unitMode = state->getUnitMode();
+  displayState.feedSelect = state->getFeedSelect();
+  displayState.motionMode = state->getMotionMode();
+  displayState.buttonLock = state->getButtonLock();
+  displayState.leftStop =
+      m_leadscrew->getStopPositionState(Leadscrew::StopPosition::LEFT);
+  displayState.rightStop =
+      m_leadscrew->getStopPositionState(Leadscrew::StopPosition::RIGHT);
+  displayState.page = state->getDisplayPage();
+  return displayState;
+}
+
+void Display::render() {
 #if ELS_DISPLAY == SSD1306_128_64
   m_ssd1306.clearDisplay();
 #endif
 
+  if (m_shownState.page == GlobalDisplayPage::DIAGNOSTICS) {
+    drawDiagnostics();
+    return;
+  }
+
   drawMode();
   drawPitch();
   drawLocked();
   drawEnabled();
   drawSpindleRpm();
   drawStopStatus();
+}
 
-#if ELS_DISPLAY == SSD1306_128_64
-  m_ssd1306.display();
-#endif
+void Display::accountUpdateTime(uint32_t micros) {
+  m_busyMicros += micros;
+  if (micros > m_maxUpdateMicros) {
+    m_maxUpdateMicros = micros;
+  }
+
+  if (m_loadWindow >= DISPLAY_LOAD_WINDOW_US) {
+    m_renderLoadPercent = (m_busyMicros * 100.0) / (uint32_t)m_loadWindow;
+    m_busyMicros = 0;
+    m_loadWindow = 0;
+  }
 }
 
+float Display::getRenderLoadPercent() { return m_renderLoadPercent; }
+
+uint32_t Display::getMaxUpdateMicros() { return m_maxUpdateMicros; }
+
 void Display::drawSpindleRpm() {
 #if ELS_DISPLAY == SSD1306_128_64
-  int rpm = m_spindle->getEstimatedVelocityInRPM();
+  // use the sampled rpm so it only changes at the rpm refresh rate
+  int rpm = m_shownState.rpm;
   char rpmString[10];
   m_ssd1306.setCursor(0, 0);
   m_ssd1306.setTextSize(1);
@@ -84,29 +187,11 @@ void Display::drawMode() {
 
 void Display::drawPitch() {
   GlobalState *state = GlobalState::getInstance();
-  GlobalUnitMode unit = state->getUnitMode();
-  GlobalFeedMode mode = state->getFeedMode();
-  int feedSelect = state->getFeedSelect();
-  char pitch[10];
-  if (unit == GlobalUnitMode::METRIC) {
-    if (mode == GlobalFeedMode::THREAD) {
-      sprintf(pitch, "%.2fmm", threadPitchMetric[feedSelect]);
-    } else {
-      sprintf(pitch, "%.2fmm", feedPitchMetric[feedSelect]);
-    }
-  } else {
-    if (mode == GlobalFeedMode::THREAD) {
-      sprintf(pitch, "%dTPI", (int)threadPitchImperial[feedSelect]);
-    } else {
-      sprintf(pitch, "%dth", (int)(feedPitchImperial[feedSelect] * 1000));
-    }
-  }
 
 #if ELS_DISPLAY == SSD1306_128_64
-  m_ssd1306.setCursor(55, 8);
-  m_ssd1306.setTextSize(2);
-  m_ssd1306.setTextColor(WHITE);
-  m_ssd1306.print(pitch);
+  m_pitchLabels.blit(m_ssd1306.getBuffer(), SCREEN_WIDTH, PITCH_LABEL_X,
+                     PITCH_LABEL_PAGE, state->getUnitMode(),
+                     state->getFeedMode(), state->getFeedSelect());
 #endif
 }
 
@@ -130,6 +215,12 @@ void Display::drawEnabled() {
     case GlobalMotionMode::ENABLED:
       m_ssd1306.drawBitmap(28, 42, runSymbol, 16, 16, BLACK);
       break;
+    case GlobalMotionMode::HOLD:
+      m_ssd1306.setCursor(28, 42);
+      m_ssd1306.setTextSize(2);
+      m_ssd1306.setTextColor(BLACK);
+      m_ssd1306.print("H");
+      break;
   }
 #endif
 }
@@ -147,4 +238,37 @@ void Display::drawLocked() {
       break;
   }
 #endif
-}
\ No newline at end of file
+}
+
+void Display::drawDiagnostics() {
+#if ELS_DISPLAY == SSD1306_128_64
+  char line[22];
+  m_ssd1306.setTextSize(1);
+  m_ssd1306.setTextColor(WHITE);
+
+  m_ssd1306.setCursor(0, 0);
+  m_ssd1306.print("DIAGNOSTICS");
+
+  m_ssd1306.setCursor(0, 16);
+  sprintf(line, "ISR load  %5.1f%%", m_isrStats->getLoadPercent());
+  m_ssd1306.print(line);
+
+  m_ssd1306.setCursor(0, 24);
+  sprintf(line, "ISR worst %5.1fus", m_isrStats->getWorstMicros());
+  m_ssd1306.print(line);
+
+  m_ssd1306.setCursor(0, 32);
+  sprintf(line, "Max error %5d", m_leadscrew->getMaxPositionError());
+  m_ssd1306.print(line);
+
+  m_ssd1306.setCursor(0, 40);
+  sprintf(line, "Steps %5lu/%lu",
+          (unsigned long)m_leadscrew->getEstimatedVelocityInPulsesPerSecond(),
+          (unsigned long)LEADSCREW_MAX_STEP_RATE);
+  m_ssd1306.print(line);
+
+  m_ssd1306.setCursor(0, 48);
+  sprintf(line, "Spindle %5dRPM", m_shownState.rpm);
+  m_ssd1306.print(line);
+#endif
+}
@@ -1,11 +1,16 @@
 
 #include <config.h>
+#include <els_elapsedMillis.h>
 #include <globalstate.h>
+#include <isr_stats.h>
 #include <leadscrew.h>
 #include <spindle.h>
 
 #define SSD1306_128_64 0
 
+// how often a display that failed to come up is tried again
+#define DISPLAY_INIT_RETRY_MS 1000
+
 #if ELS_DISPLAY == SSD1306_128_64
 
 #define SCREEN_WIDTH 128
@@ -15,6 +20,13 @@
 
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include <partial_ssd1306.h>
+#include <pitch_label_cache.h>
+
+// the pitch label is blitted straight into the frame buffer, so it has to sit
+// on a page boundary
+#define PITCH_LABEL_X 55
+#define PITCH_LABEL_PAGE 1
 
 #else
 
@@ -22,29 +34,99 @@
 
 #endif
 
+/**
+ * Everything that is shown on the display, used to decide if a redraw is
+ * required at all
+ */
+struct DisplayState {
+  int rpm;
+  GlobalFeedMode feedMode;
+  GlobalUnitMode unitMode;
+  int feedSelect;
+  GlobalMotionMode motionMode;
+  GlobalButtonLock buttonLock;
+  LeadscrewStopState leftStop;
+  LeadscrewStopState rightStop;
+  GlobalDisplayPage page;
+
+  bool operator==(const DisplayState& other) const {
+    return page == other.page && rpm == other.rpm &&
+           feedMode == other.feedMode && unitMode == other.unitMode &&
+           feedSelect == other.feedSelect && motionMode == other.motionMode &&
+           buttonLock == other.buttonLock && leftStop == other.leftStop &&
+           rightStop == other.rightStop;
+  }
+};
+
 class Display {
  private:
   Spindle* m_spindle;
   Leadscrew* m_leadscrew;
   GlobalState* m_globalState;
+  IsrStats* m_isrStats;
+
+  // what is currently in the frame buffer
+  DisplayState m_shownState;
+  bool m_shownStateValid;
+
+  bool m_initialised;
+  elapsedMillis m_initTimer;
+
+  elapsedMicros m_frameTimer;
+  elapsedMillis m_rpmTimer;
+
+  // time spent in update() over the current measurement window
+  elapsedMicros m_loadWindow;
+  uint32_t m_busyMicros;
+  float m_renderLoadPercent;
+  uint32_t m_maxUpdateMicros;
+
+#if ELS_DISPLAY == SSD1306_128_64
+  PitchLabelCache m_pitchLabels;
+#endif
+
+  DisplayState captureState();
+  void render();
+  void accountUpdateTime(uint32_t micros);
 
  public:
 #if ELS_DISPLAY == SSD1306_128_64
-  Adafruit_SSD1306 m_ssd1306;
+  PartialSSD1306 m_ssd1306;
+#endif
+  Display(Spindle* spindle, Leadscrew* leadscrew, IsrStats* isrStats)
+#if ELS_DISPLAY == SSD1306_128_64
+      : m_ssd1306(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, PIN_DISPLAY_RESET)
 #endif
-  Display(Spindle* spindle, Leadscrew* leadscrew) {
+  {
     this->m_spindle = spindle;
     this->m_leadscrew = leadscrew;
+    this->m_isrStats = isrStats;
     this->m_globalState = GlobalState::getInstance();
-#if ELS_DISPLAY == SSD1306_128_64
-    this->m_ssd1306 =
-        Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, PIN_DISPLAY_RESET);
-#endif
+    this->m_shownStateValid = false;
+    this->m_initialised = false;
+    // try to bring the display up on the first update
+    this->m_initTimer = DISPLAY_INIT_RETRY_MS;
+    this->m_busyMicros = 0;
+    this->m_renderLoadPercent = 0;
+    this->m_maxUpdateMicros = 0;
   }
 
-  void init();
+  // returns false if the display didn't respond
+  bool init();
+
+  /**
+   * Called from the main loop, brings the display up if it isn't yet,
+   * redraws the display when something on it changed and sends the frame a
+   * few pages at a time
+   */
   void update();
 
+  // percentage of the loop time spent drawing and sending frames over the
+  // last second
+  float getRenderLoadPercent();
+  // the longest a single update() call blocked the loop
+  uint32_t getMaxUpdateMicros();
+
  protected:
   void drawMode();
   void drawPitch();
@@ -52,4 +134,5 @@ class Display {
   void drawLocked();
   void drawSpindleRpm();
   void drawStopStatus();
+  void drawDiagnostics();
 };
\ No newline at end of file
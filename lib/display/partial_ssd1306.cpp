@@ -0,0 +1,113 @@
+#include "partial_ssd1306.h"
+
+#include <cstring>
+
+// the Wire transmit buffer is 32 bytes on most cores, including the control
+// byte, so larger regions are split into multiple transmissions
+#define SSD1306_WIRE_MAX 32
+
+// control byte telling the SSD1306 the rest of the transmission is pixel data
+#define SSD1306_DATA_CONTROL 0x40
+
+PartialSSD1306::PartialSSD1306(uint8_t width, uint8_t height, TwoWire* twi,
+                               int8_t resetPin)
+    : Adafruit_SSD1306(width, height, twi, resetPin),
+      m_invalidPages(0xFF),
+      m_lastFlushBytes(0) {}
+
+bool PartialSSD1306::begin(uint8_t switchvcc, uint8_t i2caddr, bool reset,
+                           bool periphBegin) {
+  bool result = Adafruit_SSD1306::begin(switchvcc, i2caddr, reset, periphBegin);
+
+  // we have no idea what the panel is showing after a reset
+  invalidate();
+  return result;
+}
+
+void PartialSSD1306::invalidate() { m_invalidPages = 0xFF; }
+
+uint32_t PartialSSD1306::getLastFlushBytes() { return m_lastFlushBytes; }
+
+void PartialSSD1306::sendRegion(uint8_t page, uint8_t startColumn,
+                                uint8_t endColumn) {
+  const uint8_t addressing[] = {SSD1306_PAGEADDR,   page,        page,
+                                SSD1306_COLUMNADDR, startColumn, endColumn};
+  ssd1306_commandList(addressing, sizeof(addressing));
+  m_lastFlushBytes += sizeof(addressing);
+
+#if ARDUINO >= 157
+  wire->setClock(wireClk);
+#endif
+
+  uint8_t* data = getBuffer() + page * WIDTH + startColumn;
+  uint16_t count = endColumn - startColumn + 1;
+
+  wire->beginTransmission(i2caddr);
+  wire->write((uint8_t)SSD1306_DATA_CONTROL);
+  uint16_t bytesOut = 1;
+  while (count--) {
+    if (bytesOut >= SSD1306_WIRE_MAX) {
+      wire->endTransmission();
+      wire->beginTransmission(i2caddr);
+      wire->write((uint8_t)SSD1306_DATA_CONTROL);
+      m_lastFlushBytes += bytesOut;
+      bytesOut = 1;
+    }
+    wire->write(*data++);
+    bytesOut++;
+  }
+  wire->endTransmission();
+  m_lastFlushBytes += bytesOut;
+
+#if ARDUINO >= 157
+  wire->setClock(restoreClk);
+#endif
+}
+
+bool PartialSSD1306::flush(uint8_t maxPages) {
+  // we only know how to address the panel over I2C, let the library handle
+  // anything else
+  if (wire == nullptr) {
+    Adafruit_SSD1306::display();
+    return true;
+  }
+
+  uint8_t* frame = getBuffer();
+  uint8_t pages = HEIGHT / SSD1306_PAGE_HEIGHT;
+  uint8_t pagesSent = 0;
+  m_lastFlushBytes = 0;
+
+  for (uint8_t page = 0; page < pages; page++) {
+    uint8_t* current = frame + page * WIDTH;
+    uint8_t* shown = m_shadow + page * WIDTH;
+
+    int16_t start = 0;
+    int16_t end = WIDTH - 1;
+    bool invalid = m_invalidPages & (1 << page);
+    if (!invalid) {
+      // narrow the region down to the first and last changed column
+      while (start < WIDTH && current[start] == shown[start]) {
+        start++;
+      }
+      if (start == WIDTH) {
+        continue;
+      }
+      while (end > start && current[end] == shown[end]) {
+        end--;
+      }
+    }
+
+    // pages already sent compare equal to the shadow, so the next call picks
+    // up where this one stopped
+    if (pagesSent == maxPages) {
+      return false;
+    }
+
+    sendRegion(page, start, end);
+    memcpy(shown + start, current + start, end - start + 1);
+    m_invalidPages &= ~(1 << page);
+    pagesSent++;
+  }
+
+  return true;
+}
@@ -0,0 +1,50 @@
+#include <Adafruit_SSD1306.h>
+
+#include <cstdint>
+
+#pragma once
+
+// the SSD1306 addresses its memory in pages of 8 vertical pixels
+#define SSD1306_PAGE_HEIGHT 8
+#define SSD1306_MAX_WIDTH 128
+#define SSD1306_MAX_PAGES 8
+
+/**
+ * An SSD1306 driver that only retransmits the parts of the frame buffer that
+ * have changed since the last flush.
+ *
+ * A shadow copy of what the panel is currently showing is kept. On flush every
+ * page is diffed against the shadow and only the changed column range of each
+ * changed page is sent using the page/column addressing commands.
+ */
+class PartialSSD1306 : public Adafruit_SSD1306 {
+ private:
+  uint8_t m_shadow[SSD1306_MAX_WIDTH * SSD1306_MAX_PAGES];
+  // one bit per page that has to be resent in full regardless of the shadow
+  uint8_t m_invalidPages;
+
+  // bytes put on the bus (commands and data) by the last flush
+  uint32_t m_lastFlushBytes;
+
+  void sendRegion(uint8_t page, uint8_t startColumn, uint8_t endColumn);
+
+ public:
+  PartialSSD1306(uint8_t width, uint8_t height, TwoWire* twi, int8_t resetPin);
+
+  bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0,
+             bool reset = true, bool periphBegin = true);
+
+  /**
+   * Send the changed regions of the frame buffer to the panel, at most
+   * maxPages pages are sent per call so a full frame doesn't block the caller
+   * Returns true once the panel matches the frame buffer
+   */
+  bool flush(uint8_t maxPages = SSD1306_MAX_PAGES);
+
+  /**
+   * Forget what the panel is showing, the next flush will send everything
+   */
+  void invalidate();
+
+  uint32_t getLastFlushBytes();
+};
@@ -0,0 +1,94 @@
+#include "pitch_label_cache.h"
+
+#include <Adafruit_GFX.h>
+
+#include <cstdio>
+#include <cstring>
+
+void PitchLabelCache::format(char* buffer, GlobalUnitMode unit,
+                             GlobalFeedMode mode, int index) {
+  if (unit == GlobalUnitMode::METRIC) {
+    if (mode == GlobalFeedMode::THREAD) {
+      sprintf(buffer, "%.2fmm", threadPitchMetric[index]);
+    } else {
+      sprintf(buffer, "%.2fmm", feedPitchMetric[index]);
+    }
+  } else {
+    if (mode == GlobalFeedMode::THREAD) {
+      sprintf(buffer, "%dTPI", (int)threadPitchImperial[index]);
+    } else {
+      sprintf(buffer, "%dth", (int)(feedPitchImperial[index] * 1000));
+    }
+  }
+}
+
+int PitchLabelCache::getTableSize(GlobalUnitMode unit, GlobalFeedMode mode) {
+  if (unit == GlobalUnitMode::METRIC) {
+    if (mode == GlobalFeedMode::THREAD) {
+      return ARRAY_SIZE(threadPitchMetric);
+    }
+    return ARRAY_SIZE(feedPitchMetric);
+  }
+  if (mode == GlobalFeedMode::THREAD) {
+    return ARRAY_SIZE(threadPitchImperial);
+  }
+  return ARRAY_SIZE(feedPitchImperial);
+}
+
+void PitchLabelCache::init() {
+  GFXcanvas1 canvas(PITCH_LABEL_WIDTH, PITCH_LABEL_PAGES * 8);
+  canvas.setTextSize(2);
+  canvas.setTextWrap(false);
+  canvas.setTextColor(1);
+
+  for (int unit = 0; unit < 2; unit++) {
+    for (int mode = 0; mode < 2; mode++) {
+      int tableSize = getTableSize((GlobalUnitMode)unit, (GlobalFeedMode)mode);
+      for (int index = 0; index < PITCH_LABEL_MAX_ENTRIES; index++) {
+        uint8_t(*label)[PITCH_LABEL_WIDTH] = m_labels[unit][mode][index];
+        memset(label, 0, PITCH_LABEL_PAGES * PITCH_LABEL_WIDTH);
+        if (index >= tableSize) {
+          continue;
+        }
+
+        // oversized so a misconfigured table entry can't overflow it
+        char text[16];
+        format(text, (GlobalUnitMode)unit, (GlobalFeedMode)mode, index);
+        canvas.fillScreen(0);
+        canvas.setCursor(0, 0);
+        canvas.print(text);
+
+        // convert from the row major canvas layout to the column major
+        // SSD1306 page layout
+        for (int page = 0; page < PITCH_LABEL_PAGES; page++) {
+          for (int x = 0; x < PITCH_LABEL_WIDTH; x++) {
+            uint8_t column = 0;
+            for (int bit = 0; bit < 8; bit++) {
+              if (canvas.getPixel(x, page * 8 + bit)) {
+                column |= 1 << bit;
+              }
+            }
+            label[page][x] = column;
+          }
+        }
+      }
+    }
+  }
+}
+
+void PitchLabelCache::blit(uint8_t* frame, int frameWidth, int x, int page,
+                           GlobalUnitMode unit, GlobalFeedMode mode,
+                           int index) {
+  if (index < 0 || index >= getTableSize(unit, mode)) {
+    return;
+  }
+
+  uint8_t(*label)[PITCH_LABEL_WIDTH] = m_labels[unit][mode][index];
+  int width = min(PITCH_LABEL_WIDTH, frameWidth - x);
+  for (int labelPage = 0; labelPage < PITCH_LABEL_PAGES; labelPage++) {
+    uint8_t* row = frame + (page + labelPage) * frameWidth + x;
+    for (int column = 0; column < width; column++) {
+      row[column] |= label[labelPage][column];
+    }
+  }
+}
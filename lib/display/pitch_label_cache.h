@@ -0,0 +1,51 @@
+#include <config.h>
+#include <globalstate.h>
+
+#include <cstdint>
+
+#pragma once
+
+// labels are drawn with the size 2 font, 12x16 pixels per character
+#define PITCH_LABEL_MAX_CHARS 6
+#define PITCH_LABEL_WIDTH (PITCH_LABEL_MAX_CHARS * 12)
+#define PITCH_LABEL_PAGES 2
+
+#define PITCH_LABEL_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define PITCH_LABEL_MAX_ENTRIES                                          \
+  PITCH_LABEL_MAX(PITCH_LABEL_MAX(ARRAY_SIZE(threadPitchMetric),         \
+                                  ARRAY_SIZE(feedPitchMetric)),          \
+                  PITCH_LABEL_MAX(ARRAY_SIZE(threadPitchImperial),       \
+                                  ARRAY_SIZE(feedPitchImperial)))
+
+/**
+ * Pre-rasterized labels for every entry of the pitch tables in config.h
+ *
+ * The labels are rendered once at startup and stored in the SSD1306 page
+ * layout (one byte is a column of 8 vertical pixels), so drawing a label is a
+ * copy straight into the frame buffer
+ */
+class PitchLabelCache {
+ private:
+  // indexed by [unit][feed mode][table index]
+  uint8_t m_labels[2][2][PITCH_LABEL_MAX_ENTRIES][PITCH_LABEL_PAGES]
+                  [PITCH_LABEL_WIDTH];
+
+ public:
+  /**
+   * Format the label for a pitch table entry, buffer must hold at least
+   * PITCH_LABEL_MAX_CHARS + 1 characters
+   */
+  static void format(char* buffer, GlobalUnitMode unit, GlobalFeedMode mode,
+                     int index);
+  static int getTableSize(GlobalUnitMode unit, GlobalFeedMode mode);
+
+  // render every label, call once before the first blit
+  void init();
+
+  /**
+   * Copy a label into a page addressed frame buffer at the given column and
+   * page, the label is OR'ed in so anything already drawn there is kept
+   */
+  void blit(uint8_t* frame, int frameWidth, int x, int page,
+            GlobalUnitMode unit, GlobalFeedMode mode, int index);
+};
@@ -7,6 +7,8 @@
 #include <elapsedMillis.h>
 #else
 
+#include <cstdint>
+
 // remove the millis and micros functions from the global namespace so we can
 // use our versions
 #undef millis
@@ -29,16 +31,21 @@ class MillisSingleton {
   }
 };
 
+/**
+ * The time is kept in 64 bits, micros() truncates it to 32 bits like the
+ * Teensy does so tests can run across the point where it wraps
+ */
 class MicrosSingleton {
  private:
-  unsigned long m_micros;
+  uint64_t m_micros;
 
  public:
   MicrosSingleton() : m_micros(0) {}
-  unsigned long micros() { return m_micros; }
+  uint32_t micros() { return m_micros; }
+  uint64_t micros64() { return m_micros; }
   void incrementMicros() { m_micros++; }
-  void incrementMicros(unsigned long micros) { m_micros += micros; }
-  void setMicros(unsigned long micros) { m_micros = micros; }
+  void incrementMicros(uint64_t micros) { m_micros += micros; }
+  void setMicros(uint64_t micros) { m_micros = micros; }
 
   static MicrosSingleton &getInstance() {
     static MicrosSingleton instance;
@@ -50,9 +57,7 @@ class MicrosSingleton {
 inline unsigned long millis() {
   return MillisSingleton::getInstance().millis();
 }
-inline unsigned long micros() {
-  return MicrosSingleton::getInstance().micros();
-}
+inline uint32_t micros() { return MicrosSingleton::getInstance().micros(); }
 
 class elapsedMillis {
  private:
@@ -128,26 +133,26 @@ class elapsedMillis {
 // any time.
 class elapsedMicros {
  private:
-  unsigned long us;
+  uint32_t us;
 
  public:
   elapsedMicros(void) { us = micros(); }
-  elapsedMicros(unsigned long val) { us = micros() - val; }
+  elapsedMicros(uint32_t val) { us = micros() - val; }
   elapsedMicros(const elapsedMicros &orig) { us = orig.us; }
-  operator unsigned long() const { return micros() - us; }
+  operator uint32_t() const { return micros() - us; }
   elapsedMicros &operator=(const elapsedMicros &rhs) {
     us = rhs.us;
     return *this;
   }
-  elapsedMicros &operator=(unsigned long val) {
+  elapsedMicros &operator=(uint32_t val) {
     us = micros() - val;
     return *this;
   }
-  elapsedMicros &operator-=(unsigned long val) {
+  elapsedMicros &operator-=(uint32_t val) {
     us += val;
     return *this;
   }
-  elapsedMicros &operator+=(unsigned long val) {
+  elapsedMicros &operator+=(uint32_t val) {
     us -= val;
     return *this;
   }
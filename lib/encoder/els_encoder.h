@@ -0,0 +1,27 @@
+// the encoder library only exists on the Teensy, this swaps in a stand-in
+// that the tests can drive for native builds
+
+#pragma once
+
+#ifndef PIO_UNIT_TESTING
+#include <Encoder.h>
+#else
+
+#include <cstdint>
+
+class Encoder {
+ private:
+  int32_t m_count;
+
+ public:
+  Encoder(uint8_t /* pinA */, uint8_t /* pinB */) : m_count(0) {}
+  int32_t read() { return m_count; }
+  void write(int32_t count) { m_count = count; }
+  int32_t readAndReset() {
+    int32_t count = m_count;
+    m_count = 0;
+    return count;
+  }
+};
+
+#endif
@@ -24,6 +24,9 @@ void GlobalState::printState() {
     case JOG:
       Serial.println("JOG");
       break;
+    case HOLD:
+      Serial.println("HOLD");
+      break;
   }
   Serial.print("Feed Mode: ");
   switch (m_feedMode) {
@@ -91,6 +94,12 @@ void GlobalState::setButtonLock(GlobalButtonLock lock) { m_buttonLock = lock; }
 
 GlobalButtonLock GlobalState::getButtonLock() { return m_buttonLock; }
 
+void GlobalState::setDisplayPage(GlobalDisplayPage page) {
+  m_displayPage = page;
+}
+
+GlobalDisplayPage GlobalState::getDisplayPage() { return m_displayPage; }
+
 void GlobalState::setFeedSelect(int select) {
   if (select >= 0 && select < getCurrentFeedSelectArraySize()) {
     m_feedSelect = select;
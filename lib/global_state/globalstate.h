@@ -13,7 +13,9 @@ enum GlobalFeedMode { FEED, THREAD };
 // Disabled: The leadscrew does not move when the spindle is moving
 // Jog: The leadscrew is moving independently of the spindle
 // Enabled: The leadscrew is moving in sync with the spindle
-enum GlobalMotionMode { DISABLED, JOG, ENABLED };
+// Hold: The leadscrew is stopped mid pass but keeps track of the spindle, so it
+// can pick the pass back up where it left it
+enum GlobalMotionMode { DISABLED, JOG, ENABLED, HOLD };
 
 /**
  * The unit mode of the application, usually for threading
@@ -36,6 +38,13 @@ enum GlobalThreadSyncState { SYNC, UNSYNC };
  */
 enum GlobalButtonLock { UNLOCKED, LOCKED };
 
+/**
+ * The page shown on the display
+ * Status: The normal mode/pitch/status screen
+ * Diagnostics: Live timing and following error of the motion core
+ */
+enum GlobalDisplayPage { STATUS, DIAGNOSTICS };
+
 // this is a singleton class - we don't want more than one of these existing at
 // a time!
 class GlobalState {
@@ -47,6 +56,7 @@ class GlobalState {
   GlobalUnitMode m_unitMode;
   GlobalThreadSyncState m_threadSyncState;
   GlobalButtonLock m_buttonLock;
+  GlobalDisplayPage m_displayPage;
 
   int m_feedSelect;
 
@@ -62,6 +72,7 @@ class GlobalState {
     setButtonLock(LOCKED);
     setFeedSelect(-1);
     setThreadSyncState(UNSYNC);
+    setDisplayPage(STATUS);
     m_motionMode = DISABLED;
     m_resyncPulseCount = 0;
   }
@@ -89,6 +100,9 @@ class GlobalState {
   void setButtonLock(GlobalButtonLock lock);
   GlobalButtonLock getButtonLock();
 
+  void setDisplayPage(GlobalDisplayPage page);
+  GlobalDisplayPage getDisplayPage();
+
   void setFeedSelect(int select);
   int getFeedSelect();
   float getCurrentFeedPitch();
@@ -0,0 +1,37 @@
+#include "handwheel.h"
+
+Handwheel::Handwheel(int pinA, int pinB, int countsPerDetent)
+    : m_encoder(pinA, pinB),
+      countsPerDetent(countsPerDetent),
+      m_partialCounts(0),
+      m_unconsumedDetents(0),
+      m_ratio(1) {}
+
+void Handwheel::update() {
+  // a count that comes in between a separate read and write would be lost
+  int counts = m_encoder.readAndReset();
+  if (counts == 0) {
+    return;
+  }
+
+  // only whole detents move the leadscrew, otherwise resting the wheel
+  // between two detents would make it creep
+  m_partialCounts += counts;
+  int detents = m_partialCounts / countsPerDetent;
+  m_partialCounts -= detents * countsPerDetent;
+
+  m_unconsumedDetents += detents;
+  incrementCurrentPosition(detents);
+}
+
+void Handwheel::setRatio(float ratio) { m_ratio = ratio; }
+
+float Handwheel::getRatio() { return m_ratio; }
+
+bool Handwheel::hasUnconsumedSteps() { return m_unconsumedDetents != 0; }
+
+int Handwheel::consumeSteps() {
+  int detents = m_unconsumedDetents;
+  m_unconsumedDetents = 0;
+  return detents * m_ratio;
+}
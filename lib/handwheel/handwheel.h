@@ -0,0 +1,46 @@
+#include <axis.h>
+#include <els_encoder.h>
+
+#pragma once
+
+/**
+ * A manual pulse generator (MPG) handwheel
+ *
+ * The quadrature signal is decoded by the encoder library on pin interrupts,
+ * the ratio is the multiplier of leadscrew steps per detent. The position is
+ * counted in detents
+ */
+class Handwheel : public Axis, public DerivedAxis {
+ private:
+  Encoder m_encoder;
+  const int countsPerDetent;
+
+  // raw encoder counts that haven't made up a full detent yet
+  int m_partialCounts;
+  // detents that haven't been turned into motion yet
+  volatile int m_unconsumedDetents;
+
+  float m_ratio;
+
+ public:
+  Handwheel(int pinA, int pinB, int countsPerDetent);
+
+#ifdef PIO_UNIT_TESTING
+  // tests turn the wheel by writing raw counts into the encoder
+  Encoder& getEncoder() { return m_encoder; }
+#endif
+
+  // called from the timer to pick up new encoder counts
+  void update();
+
+  void setRatio(float ratio);
+  float getRatio();
+
+  // true if the wheel was turned since the last consume
+  bool hasUnconsumedSteps();
+  /**
+   * Return the leadscrew steps the wheel was turned by since the last call,
+   * i.e detents times the multiplier
+   */
+  int consumeSteps();
+};
@@ -6,295 +6,632 @@
 #include <cstdint>
 #include <cstdio>
 
-#include "leadscrew_io.h"
 using namespace std;
 
-Leadscrew::Leadscrew(Spindle* spindle, LeadscrewIO* io, float initialPulseDelay,
+Leadscrew::Leadscrew(Spindle* spindle, StepperIO* io, float initialPulseDelay,
                      float pulseDelayIncrement, int motorPulsePerRevolution,
                      float leadscrewPitch)
-    : motorPulsePerRevolution(motorPulsePerRevolution),
-      leadscrewPitch(leadscrewPitch),
-      initialPulseDelay(initialPulseDelay),
-      pulseDelayIncrement(pulseDelayIncrement),
-      m_io(io),
+    : StepperAxis(io, initialPulseDelay, pulseDelayIncrement,
+                  motorPulsePerRevolution, leadscrewPitch),
       m_spindle(spindle),
-      m_accumulator(0),
-      m_currentDirection(LeadscrewDirection::UNKNOWN),
-      m_leftStopState(LeadscrewStopState::UNSET),
-      m_rightStopState(LeadscrewStopState::UNSET),
-      m_currentPulseDelay(initialPulseDelay) {
-  setRatio(GlobalState::getInstance()->getCurrentFeedPitch());
-  m_lastPulseMicros = 0;
-  m_lastFullPulseDurationMicros = 0;
-  m_expectedPosition = 0;
-  m_currentPosition = 0;
+      m_maxPositionError(0),
+      m_jogTargetSpeed(0),
+      m_jogSpeed(0),
+      m_jogProgress(0),
+      m_jogRequestedNm(0),
+      m_jogStartedNm(0),
+      m_handwheel(nullptr),
+      m_handwheelEnabled(false) {
+  GlobalState* globalState = GlobalState::getInstance();
+  m_pendingConfig.mode = GlobalMotionMode::DISABLED;
+  m_pendingConfig.ratio = globalState->getCurrentFeedPitch();
+  m_pendingConfig.ratioNm = llround(m_pendingConfig.ratio * NM_PER_MM);
+  m_pendingConfig.leftStopState = LeadscrewStopState::UNSET;
+  m_pendingConfig.leftStopPosition = INT64_MIN;
+  m_pendingConfig.rightStopState = LeadscrewStopState::UNSET;
+  m_pendingConfig.rightStopPosition = INT64_MAX;
+  m_pendingConfig.threadSync = false;
+  m_pendingConfig.threadStart = 0;
+  m_pendingConfig.threadStarts = 1;
+  m_pendingConfig.threadGeneration = 0;
+  m_config = m_pendingConfig;
+  publishConfig();
+  m_parked = false;
+
+  m_spindleCount = 0;
+  m_gearbox.rebase(0, 0);
+  m_gearbox.numerator = m_config.ratioNm;
+  m_gearbox.denominator = m_constants.spindlePulsePerRevolution;
+
+  m_threadPhase = m_gearbox;
+  m_threadPhaseValid = false;
+  m_threadStartOffset = 0;
+  m_threadGeneration = 0;
+  m_previousMode = m_config.mode;
+
+  m_resumeState = RESUME_NONE;
+  m_holdPosition = 0;
+  m_spindleDirection = 1;
+  m_resumeSpeed = 0;
+  m_resumeAccel = 0;
+  m_resumeLead = 0;
+
+  m_spindleSpeed = 0;
+  m_spindleAccel = 0;
+  m_spindleWindowCount = 0;
 }
 
-void Leadscrew::setRatio(float ratio) {
-  // reset the positions to base values
-  m_currentPosition /= m_ratio;
-  if (m_leftStopState == LeadscrewStopState::SET) {
-    m_leftStopPosition /= m_ratio;
+void Leadscrew::publishConfig() {
+  m_publishedConfig.write(m_pendingConfig);
+  m_configChanged = true;
+}
+
+void Leadscrew::readConfig() {
+  // if the main loop is in the middle of publishing we were interrupted, keep
+  // going with the previous snapshot and pick the change up next time, the
+  // flag is set again once it is done
+  m_configChanged = false;
+  m_publishedConfig.tryRead(m_config);
+}
+
+bool Leadscrew::isSpindleStopped() {
+  // the spindle's own estimate reads 0 below a count per millisecond, well into
+  // threading speeds, so this goes by the counts the leadscrew has consumed
+  return m_spindleSpeed == 0 && m_spindleCount == m_spindleWindowCount;
+}
+
+void Leadscrew::updateRatio(int spindleDelta) {
+  bool spindleStopped = isSpindleStopped();
+  int64_t previousCount = m_spindleCount;
+  m_spindleCount += spindleDelta;
+  if (spindleDelta != 0) {
+    m_spindleDirection = spindleDelta > 0 ? 1 : -1;
+  }
+
+  if (m_config.ratioNm == m_gearbox.numerator) {
+    return;
+  }
+
+  // while cutting the change is held back until the spindle passes a
+  // revolution boundary, so every pass changes ratio at the same phase.
+  // Anywhere else it happens right away, before this tick's movement
+  int64_t changeCount = previousCount;
+  bool engaged = m_config.mode == GlobalMotionMode::ENABLED ||
+                 m_config.mode == GlobalMotionMode::HOLD;
+  if (engaged && !spindleStopped) {
+    if (spindleDelta == 0) {
+      return;
+    }
+
+    // the first boundary after the previous count in the direction of travel
+    int pulsesPerRevolution = m_constants.spindlePulsePerRevolution;
+    int64_t boundary = previousCount - (previousCount % pulsesPerRevolution);
+    if (boundary > previousCount) {
+      boundary -= pulsesPerRevolution;
+    }
+    if (spindleDelta > 0) {
+      boundary += pulsesPerRevolution;
+    } else if (boundary == previousCount) {
+      boundary -= pulsesPerRevolution;
+    }
+
+    bool crossed = spindleDelta > 0 ? m_spindleCount >= boundary
+                                     : m_spindleCount <= boundary;
+    if (!crossed) {
+      return;
+    }
+    changeCount = boundary;
+  }
+
+  // re-base the gearbox at the change point, the expected position carries on
+  // from exactly where the old ratio left it so the carriage doesn't jump
+  m_gearbox.rebase(changeCount, m_gearbox.output(changeCount));
+  m_gearbox.numerator = m_config.ratioNm;
+}
+
+void Leadscrew::updateSpindleSpeed() {
+  uint64_t elapsed = m_spindleWindowTimer;
+  if (elapsed < ELS_SPINDLE_DECEL_WINDOW_US) {
+    return;
+  }
+
+  float seconds = (float)elapsed / US_PER_SECOND;
+  float speed = (m_spindleCount - m_spindleWindowCount) / seconds;
+  m_spindleAccel = (speed - m_spindleSpeed) / seconds;
+  m_spindleSpeed = speed;
+  m_spindleWindowCount = m_spindleCount;
+  m_spindleWindowTimer = 0;
+}
+
+bool Leadscrew::getTurnaroundPosition(int64_t& position) {
+  // only until it has turned, the last window can still be from before
+  if (m_spindleSpeed == 0 || m_spindleSpeed * m_spindleAccel >= 0 ||
+      m_spindleSpeed * m_spindleDirection < 0) {
+    return false;
+  }
+
+  // the speed is the average over the last window, bring it up to now
+  float seconds = ((float)(uint64_t)m_spindleWindowTimer +
+                   ELS_SPINDLE_DECEL_WINDOW_US / 2) /
+                  US_PER_SECOND;
+  float speed = m_spindleSpeed + m_spindleAccel * seconds;
+  if (speed * m_spindleSpeed <= 0) {
+    // it should have turned by now, so it's only slowing down
+    return false;
+  }
+  int64_t counts =
+      (int64_t)(speed * fabs(speed) / (2 * fabs(m_spindleAccel)));
+  position = m_gearbox.output(m_spindleCount + counts);
+  return true;
+}
+
+void Leadscrew::rebaseExpectedPosition(int64_t position) {
+  m_gearbox.rebase(m_spindleCount, position);
+}
+
+int64_t Leadscrew::getThreadStartOffset() {
+  int starts = m_config.threadStarts;
+  if (starts <= 1) {
+    return 0;
+  }
+  // rounded to the nearest count if the PPR doesn't divide by the starts
+  int64_t counts =
+      (int64_t)m_config.threadStart * m_constants.spindlePulsePerRevolution;
+  return (counts + starts / 2) / starts;
+}
+
+void Leadscrew::alignToTurn(Gearbox& gearbox, int64_t position) {
+  // the thread repeats every pitch whichever way it's cut
+  int64_t pitch = llabs(gearbox.numerator);
+  if (pitch == 0) {
+    return;
+  }
+  int64_t distance = position - gearbox.output(m_spindleCount);
+  int64_t turns =
+      (distance >= 0 ? distance + pitch / 2 : distance - pitch / 2) / pitch;
+  gearbox.outputOrigin += turns * pitch;
+}
+
+void Leadscrew::disengage() {
+  m_threadPhase = m_gearbox;
+  m_threadPhase.inputOrigin -= m_threadStartOffset;
+  m_threadPhaseValid = true;
+}
+
+void Leadscrew::engage() {
+  int64_t startOffset = getThreadStartOffset();
+
+  // a new thread, the carriage is on it wherever it is now. A new ratio is a
+  // new thread too
+  int64_t pitch = m_threadPhase.numerator;
+  if (!m_config.threadSync || !m_threadPhaseValid ||
+      pitch != m_gearbox.numerator || pitch <= 0) {
+    m_threadStartOffset = startOffset;
+    return;
+  }
+
+  // get onto the turn of the thread nearest to the carriage so it never moves
+  // more than half a pitch
+  Gearbox phase = m_threadPhase;
+  phase.inputOrigin += startOffset;
+  alignToTurn(phase, stepsToNm(m_currentSteps));
+
+  m_gearbox = phase;
+  m_threadStartOffset = startOffset;
+}
+
+void Leadscrew::hold() {
+  // ramp down from the current speed without turning back, the gearbox
+  // carries on with the spindle so the thread isn't lost
+  m_holdPosition = stepsToNm(m_currentSteps) +
+                   m_currentDirection * stepsToNm(getPulsesToStop());
+  m_resumeState = RESUME_NONE;
+}
+
+void Leadscrew::startResume() {
+  float countsPerSecond = isSpindleStopped() ? 0 : m_spindleSpeed;
+  m_resumeSpeed = countsPerSecond * m_gearbox.numerator / m_gearbox.denominator;
+  // half the jog acceleration so the ramp can actually be followed
+  m_resumeAccel = m_constants.jogAccel * NM_PER_MM / 2;
+
+  if (m_resumeSpeed == 0 || m_resumeAccel <= 0) {
+    // nothing to merge with, get onto the nearest turn of the thread
+    alignToTurn(m_gearbox, m_holdPosition);
+    m_resumeState = RESUME_NONE;
+    return;
   }
-  if (m_rightStopState == LeadscrewStopState::SET) {
-    m_rightStopPosition /= m_ratio;
+
+  m_resumeLead = INT64_MAX;
+  m_resumeState = RESUME_WAITING;
+}
+
+int64_t Leadscrew::updateResume() {
+  int64_t target = m_gearbox.output(m_spindleCount);
+  int direction = m_resumeSpeed > 0 ? 1 : -1;
+
+  if (m_resumeState == RESUME_WAITING && isSpindleStopped()) {
+    // the spindle stopped while we were waiting for it
+    alignToTurn(m_gearbox, m_holdPosition);
+    m_resumeState = RESUME_NONE;
+    return m_gearbox.output(m_spindleCount);
+  }
+
+  if (m_resumeState == RESUME_WAITING) {
+    // ramping up from standstill to the spindle's speed covers half the
+    // distance the thread does meanwhile, so the ramp has to start with the
+    // thread that far behind the carriage
+    float rampDistance =
+        m_resumeSpeed * m_resumeSpeed / (2 * m_resumeAccel);
+    int64_t pitch = llabs(m_gearbox.numerator);
+    int64_t lead =
+        (m_holdPosition - target) * direction - (int64_t)rampDistance;
+    lead %= pitch;
+    if (lead < 0) {
+      lead += pitch;
+    }
+
+    // the lead shrinks as the spindle turns and jumps up by a pitch once the
+    // thread has passed the start of the ramp. Wait for the carriage to come
+    // to a stop first
+    bool passed = m_resumeLead != INT64_MAX && lead > m_resumeLead + pitch / 2;
+    m_resumeLead = lead;
+    if (!passed || getPositionError() != 0 ||
+        m_currentDirection != LeadscrewDirection::UNKNOWN) {
+      return m_holdPosition;
+    }
+
+    alignToTurn(m_gearbox,
+                m_holdPosition - direction * (int64_t)rampDistance);
+    target = m_gearbox.output(m_spindleCount);
+    m_resumeTimer = 0;
+    m_resumeState = RESUME_MERGING;
+  }
+
+  // ramp up until the thread catches the carriage at full speed
+  float seconds = (float)(uint64_t)m_resumeTimer / US_PER_SECOND;
+  int64_t ramp = m_holdPosition + direction * (int64_t)(m_resumeAccel *
+                                                        seconds * seconds / 2);
+  bool caughtUp = (target - ramp) * direction >= 0;
+  if (caughtUp || m_resumeAccel * seconds >= fabs(m_resumeSpeed)) {
+    m_resumeState = RESUME_NONE;
+    return target;
   }
+  return ramp;
+}
 
-  m_ratio = ratio;
-  // extrapolate the current position based on the new ratio
-  m_currentPosition *= m_ratio;
-  if (m_leftStopState == LeadscrewStopState::SET) {
-    m_leftStopPosition *= m_ratio;
+void Leadscrew::setThreadSync(bool sync) {
+  if (m_pendingConfig.threadSync == sync) {
+    return;
   }
-  if (m_rightStopState == LeadscrewStopState::SET) {
-    m_rightStopPosition *= m_ratio;
+  m_pendingConfig.threadSync = sync;
+  publishConfig();
+}
+
+void Leadscrew::setThreadStart(int start, int starts) {
+  if (starts < 1 || start < 0 || start >= starts) {
+    return;
   }
+  m_pendingConfig.threadStart = start;
+  m_pendingConfig.threadStarts = starts;
+  publishConfig();
 }
 
-float Leadscrew::getRatio() { return m_ratio; }
+int Leadscrew::getThreadStart() { return m_pendingConfig.threadStart; }
+
+int Leadscrew::getThreadStarts() { return m_pendingConfig.threadStarts; }
 
-int Leadscrew::getExpectedPosition() {
-  return m_expectedPosition;
+void Leadscrew::resetThreadPhase() {
+  m_pendingConfig.threadGeneration++;
+  publishConfig();
 }
 
-int Leadscrew::getCurrentPosition() { return m_currentPosition; }
+void Leadscrew::setMotionMode(GlobalMotionMode mode) {
+  if (m_pendingConfig.mode == mode) {
+    return;
+  }
+  m_pendingConfig.mode = mode;
+  publishConfig();
+}
 
-void Leadscrew::resetCurrentPosition() {
-  m_currentPosition = m_expectedPosition;
+void Leadscrew::setRatio(float ratio) {
+  if (ratio == m_pendingConfig.ratio) {
+    return;
+  }
+
+  // the change is queued, update() applies it at a safe spindle position
+  // without moving the carriage, so the positions and stops stay as they are
+  m_pendingConfig.ratio = ratio;
+  m_pendingConfig.ratioNm = llround(ratio * NM_PER_MM);
+  publishConfig();
 }
 
+float Leadscrew::getRatio() { return m_pendingConfig.ratio; }
+
 void Leadscrew::unsetStopPosition(StopPosition position) {
   switch (position) {
     case LEFT:
-      m_leftStopState = LeadscrewStopState::UNSET;
-      m_leftStopPosition = INT32_MIN;
+      m_pendingConfig.leftStopState = LeadscrewStopState::UNSET;
+      m_pendingConfig.leftStopPosition = INT64_MIN;
       break;
     case RIGHT:
-      m_rightStopState = LeadscrewStopState::UNSET;
-      m_rightStopPosition = INT32_MAX;
+      m_pendingConfig.rightStopState = LeadscrewStopState::UNSET;
+      m_pendingConfig.rightStopPosition = INT64_MAX;
       break;
   }
+  publishConfig();
 }
 
-void Leadscrew::setStopPosition(StopPosition position, int stopPosition) {
+void Leadscrew::setStopPosition(StopPosition position, int64_t stopPosition) {
   switch (position) {
     case LEFT:
-      m_leftStopPosition = stopPosition;
-      m_leftStopState = LeadscrewStopState::SET;
+      m_pendingConfig.leftStopPosition = stopPosition;
+      m_pendingConfig.leftStopState = LeadscrewStopState::SET;
       break;
     case RIGHT:
-      m_rightStopPosition = stopPosition;
-      m_rightStopState = LeadscrewStopState::SET;
+      m_pendingConfig.rightStopPosition = stopPosition;
+      m_pendingConfig.rightStopState = LeadscrewStopState::SET;
       break;
   }
+  publishConfig();
 }
 
 LeadscrewStopState Leadscrew::getStopPositionState(StopPosition position) {
   switch (position) {
     case LEFT:
-      return m_leftStopState;
+      return m_pendingConfig.leftStopState;
     case RIGHT:
-      return m_rightStopState;
+      return m_pendingConfig.rightStopState;
   }
+  return LeadscrewStopState::UNSET;
 }
 
-int Leadscrew::getStopPosition(StopPosition position) {
+int64_t Leadscrew::getStopPosition(StopPosition position) {
   // todo better default values when unset
   switch (position) {
     case LEFT:
-      if (m_leftStopState == LeadscrewStopState::SET) {
-        return m_leftStopPosition;
+      if (m_pendingConfig.leftStopState == LeadscrewStopState::SET) {
+        return m_pendingConfig.leftStopPosition;
       }
-      return INT32_MIN;
+      return INT64_MIN;
     case RIGHT:
-      if (m_rightStopState == LeadscrewStopState::SET) {
-        return m_rightStopPosition;
+      if (m_pendingConfig.rightStopState == LeadscrewStopState::SET) {
+        return m_pendingConfig.rightStopPosition;
       }
-      return INT32_MAX;
+      return INT64_MAX;
   }
   return 0;
 }
 
-void Leadscrew::setCurrentPosition(int position) {
-  m_currentPosition = position;
+void Leadscrew::setJogSpeed(float mmPerSecond) {
+  m_jogTargetSpeed = mmPerSecond;
 }
 
-void Leadscrew::incrementCurrentPosition(int amount) {
-  m_currentPosition += amount;
+void Leadscrew::setHandwheel(Handwheel* handwheel) {
+  m_handwheel = handwheel;
 }
 
-float Leadscrew::getAccumulatorUnit() { return getRatio() / leadscrewPitch; }
+void Leadscrew::setHandwheelEnabled(bool enabled) {
+  m_handwheelEnabled = enabled;
+}
 
-bool Leadscrew::sendPulse() {
-  uint8_t pinState = m_io->readStepPin();
+void Leadscrew::updateHandwheel() {
+  GlobalMotionMode mode = m_config.mode;
+  if (!m_handwheelEnabled || mode == GlobalMotionMode::ENABLED) {
+    m_handwheel->consumeSteps();
+    return;
+  }
 
-  // Keep the pulse pin high as long as we're not scheduled to send a pulse
-  if (pinState == 1) {
-    m_io->writeStepPin(0);
+  // the main loop switches to jogging when it sees the wheel was turned
+  if (mode != GlobalMotionMode::JOG) {
+    return;
+  }
 
+  int steps = m_handwheel->consumeSteps();
+  if (steps == 0) {
+    return;
+  }
+  int64_t distance = stepsToNm(steps);
+
+  // the leadscrew ramps towards the new position like any other move, limit
+  // how far behind it can get so a fast spin can't queue up a runaway move
+  int64_t maxBacklog = (int64_t)ELS_MPG_MAX_BACKLOG_MM * NM_PER_MM;
+  int64_t backlog = m_expectedPosition - stepsToNm(m_currentSteps);
+  if (distance > 0) {
+    distance = min(distance, max((int64_t)0, maxBacklog - backlog));
   } else {
-    m_io->writeStepPin(1);
+    distance = max(distance, min((int64_t)0, -maxBacklog - backlog));
   }
 
-  return pinState == 1;
+  m_gearbox.outputOrigin += distance;
 }
 
-/**
- * Due to the cumulative nature of the pulses when stopping, we can model the
- * stopping distance as a quadratic equation.
- * This function calculates the number of pulses required to stop the leadscrew
- * from a given pulse delay
- */
-int calculate_pulses_to_stop(float currentPulseDelay, float initialPulseDelay,
-                             float pulseDelayIncrement) {
-  // Calculate the discriminant
-  float discriminant = currentPulseDelay * currentPulseDelay -
-                       4 * (pulseDelayIncrement / 2.0) * (-initialPulseDelay);
+void Leadscrew::jogDistance(float mm) {
+  // a move of over 2m would wrap the difference, no lathe is that long
+  m_jogRequestedNm += (uint32_t)(int32_t)llround(mm * NM_PER_MM);
+}
 
-  // Ensure the discriminant is non-negative for real roots
-  if (discriminant >= 0) {
-    // Calculate the square root of the discriminant
-    float sqrtDiscriminant = sqrt(discriminant);
+int32_t Leadscrew::getPendingJogNm() {
+  return (int32_t)(m_jogRequestedNm - m_jogStartedNm);
+}
 
-    // Calculate the positive root using the quadratic formula
-    float n =
-        (-currentPulseDelay + sqrtDiscriminant) / (2 * pulseDelayIncrement);
+bool Leadscrew::isJogging() {
+  return m_jogTargetSpeed != 0 || m_jogSpeed != 0 ||
+         getPendingJogNm() != 0 ||
+         (m_handwheel != nullptr && m_handwheel->hasUnconsumedSteps()) ||
+         getPositionError() != 0;
+}
 
-    // Round up to the nearest integer because pulses must be whole numbers
-    return abs((int)ceil(n));
-  } else {
-    // If the discriminant is negative, return 0 as a fallback (no real
-    // solution)
+void Leadscrew::updateJog() {
+  float elapsedSeconds = (float)(uint64_t)m_jogTimer / US_PER_SECOND;
+  m_jogTimer = 0;
+
+  // ramp towards the commanded speed
+  float maxChange = m_constants.jogAccel * elapsedSeconds;
+  float target = m_jogTargetSpeed;
+  target =
+      max(-m_constants.maxJogSpeed, min(target, m_constants.maxJogSpeed));
+  if (m_jogSpeed < target) {
+    m_jogSpeed = min(m_jogSpeed + maxChange, target);
+  } else if (m_jogSpeed > target) {
+    m_jogSpeed = max(m_jogSpeed - maxChange, target);
+  }
+
+  // fixed distance jogs are handed straight to the leadscrew, which ramps
+  // the move itself
+  int32_t distance = getPendingJogNm();
+  if (distance != 0) {
+    m_jogStartedNm += distance;
+    m_gearbox.outputOrigin += distance;
+  }
+
+  if (m_jogSpeed == 0) {
+    m_jogProgress = 0;
+    return;
+  }
+
+  m_jogProgress += m_jogSpeed * elapsedSeconds * NM_PER_MM;
+  int64_t nm = (int64_t)m_jogProgress;
+  m_jogProgress -= nm;
+  m_gearbox.outputOrigin += nm;
+}
+
+uint64_t Leadscrew::getNextUpdateMicros() {
+  // following the spindle or a jog moves the expected position every tick
+  bool moving = m_configChanged || m_spindle->hasUnconsumedPosition() ||
+                m_jogTargetSpeed != 0 || m_jogSpeed != 0 ||
+                getPendingJogNm() != 0 ||
+                (m_handwheel != nullptr && m_handwheel->hasUnconsumedSteps()) ||
+                m_resumeState != RESUME_NONE || m_spindleSpeed != 0 ||
+                m_spindleAccel != 0 || hasFeedbackMoved();
+  if (moving) {
     return 0;
   }
+
+  // otherwise it is only stepping to where it should be, which can wait for
+  // the next edge. The update after the last step settles the direction
+  uint64_t deadline = UINT64_MAX;
+  if (getPositionError() != 0) {
+    deadline = getNextEdgeMicros();
+  } else if (m_currentDirection != LeadscrewDirection::UNKNOWN) {
+    deadline = 0;
+  }
+  if (deadline != 0) {
+    m_parked = true;
+  }
+  return deadline;
 }
 
 void Leadscrew::update() {
-  GlobalState* globalState = GlobalState::getInstance();
+  readConfig();
+  if (m_parked) {
+    // start timing the jog and the spindle from now, not from when it parked
+    m_parked = false;
+    m_jogTimer = 0;
+    m_spindleWindowTimer = 0;
+    m_spindleWindowCount = m_spindleCount;
+  }
+  // the spindle PPR can change with the machine profile
+  m_gearbox.denominator = m_constants.spindlePulsePerRevolution;
 
   // consume the pulses from the spindle
-  // since the spindle is a rotational axis, it keeps track of the pulses that 
-  m_expectedPosition += m_spindle->consumePosition() * getRatio();
+  updateRatio(m_spindle->consumePosition());
+  updateSpindleSpeed();
 
-  int positionError = getPositionError();
+  if (m_config.threadGeneration != m_threadGeneration) {
+    m_threadGeneration = m_config.threadGeneration;
+    m_threadPhaseValid = false;
+  }
+  // held passes are still engaged, the gearbox keeps following the spindle
+  bool engaged = m_config.mode == GlobalMotionMode::ENABLED ||
+                 m_config.mode == GlobalMotionMode::HOLD;
+  bool wasEngaged = m_previousMode == GlobalMotionMode::ENABLED ||
+                    m_previousMode == GlobalMotionMode::HOLD;
+  if (wasEngaged && !engaged) {
+    disengage();
+    m_resumeState = RESUME_NONE;
+  }
 
-  switch (globalState->getMotionMode()) {
+  switch (m_config.mode) {
     case GlobalMotionMode::DISABLED:
-      // ignore the spindle, pretend we're in sync all the time
-      resetCurrentPosition();
+      // nothing drives the leadscrew, its target stays wherever it is
+      followFeedback();
+      rebaseExpectedPosition(stepsToNm(m_currentSteps));
+      m_jogSpeed = 0;
+      m_jogTimer = 0;
       break;
     case GlobalMotionMode::JOG:
+      // jogging is independent of the spindle, only the jog moves the target
+      rebaseExpectedPosition(m_expectedPosition);
+      updateJog();
+      break;
     case GlobalMotionMode::ENABLED:
-      LeadscrewDirection nextDirection = LeadscrewDirection::UNKNOWN;
-
-      /**
-       * Attempt to find the "next" direction to move in, if the current
-       * direction is unknown i.e: at a standstill - we know we have to start
-       * moving in that direction
-       *
-       * If the next direction is different from the current direction, we
-       * should start decelerating to move in the intended direction
-       */
-      if (positionError > 0) {
-        nextDirection = LeadscrewDirection::RIGHT;
-        if (m_currentDirection == LeadscrewDirection::LEFT &&
-            m_currentPulseDelay == initialPulseDelay) {
-          m_currentDirection = LeadscrewDirection::UNKNOWN;
-        }
-        if (m_currentDirection == LeadscrewDirection::UNKNOWN) {
-          m_io->writeDirPin(1);
-          m_currentDirection = LeadscrewDirection::RIGHT;
-          m_accumulator = m_currentDirection * getAccumulatorUnit();
-        }
-
-      } else if (positionError < 0) {
-        nextDirection = LeadscrewDirection::LEFT;
-        if (m_currentDirection == LeadscrewDirection::RIGHT &&
-            m_currentPulseDelay == initialPulseDelay) {
-          m_currentDirection = LeadscrewDirection::UNKNOWN;
-        }
-        if (m_currentDirection == LeadscrewDirection::UNKNOWN) {
-          m_io->writeDirPin(0);
-          m_currentDirection = LeadscrewDirection::LEFT;
-          m_accumulator = m_currentDirection * getAccumulatorUnit();
-        }
-      } else {
-        m_currentDirection = LeadscrewDirection::UNKNOWN;
-        break;
+      if (!wasEngaged) {
+        engage();
+      } else if (m_previousMode == GlobalMotionMode::HOLD) {
+        startResume();
+      }
+      break;
+    case GlobalMotionMode::HOLD:
+      if (!wasEngaged) {
+        engage();
+      }
+      if (m_previousMode != GlobalMotionMode::HOLD) {
+        hold();
       }
+      break;
+  }
+  m_previousMode = m_config.mode;
 
-      bool hitEndstop = (m_rightStopState == LeadscrewStopState::SET &&
-                         m_currentPosition >= m_rightStopPosition &&
-                         m_currentDirection == LeadscrewDirection::RIGHT) ||
-                        (m_leftStopState == LeadscrewStopState::SET &&
-                         m_currentPosition <= m_leftStopPosition &&
-                         m_currentDirection == LeadscrewDirection::LEFT);
+  if (m_handwheel != nullptr) {
+    updateHandwheel();
+  }
 
-      // check if we're scheduled for a pulse
-      if (m_lastPulseMicros < m_currentPulseDelay || hitEndstop) {
-        break;
-      }
+  // the expected position is always worked out from the spindle count since
+  // the last ratio change, so it doesn't pick up rounding errors over time
+  if (m_config.mode == GlobalMotionMode::HOLD) {
+    m_expectedPosition = m_holdPosition;
+  } else if (m_resumeState != RESUME_NONE) {
+    m_expectedPosition = updateResume();
+  } else {
+    m_expectedPosition = m_gearbox.output(m_spindleCount);
+  }
 
-      // attempt to keep in sync with the leadscrew
-      // if sendPulse returns true, we've actually sent a pulse
-      if (sendPulse()) {
-        m_lastFullPulseDurationMicros =
-            min((uint32_t)m_lastPulseMicros, (uint32_t)initialPulseDelay);
-        m_lastPulseMicros = 0;
-
-        // handle position update
-        if (m_accumulator > 1 || m_accumulator < -1) {
-          m_accumulator -= m_currentDirection;
-        } else {
-          m_currentPosition += m_currentDirection;
-          m_accumulator += m_currentDirection * getAccumulatorUnit();
-        }
-
-        // calculate the stopping time
-        int pulsesToStop = calculate_pulses_to_stop(
-            m_currentPulseDelay, initialPulseDelay, pulseDelayIncrement);
-
-        // if this is true we should start decelerating to stop at the
-        // correct position
-        bool shouldStop = abs(positionError) <= pulsesToStop ||
-                          nextDirection != m_currentDirection || hitEndstop;
-
-        float accelChange = pulseDelayIncrement * m_lastFullPulseDurationMicros;
-
-        if (shouldStop) {
-          m_currentPulseDelay += accelChange;
-        } else {
-          m_currentPulseDelay -= accelChange;
-        }
-
-        // if pulse is sent we want to calculate how much to change the timing
-        // for the next pulse
-        // depending on accel and current speed etc
-        // inital pulse delay is upper timing limit
-        //
-        if (m_currentPulseDelay > initialPulseDelay) {
-          m_currentPulseDelay = initialPulseDelay;
-        }
-        if (m_currentPulseDelay < 0) {
-          m_currentPulseDelay = 0;
-        }
-      }
+  int positionError = getPositionError();
+  if (m_config.mode == GlobalMotionMode::ENABLED &&
+      m_resumeState == RESUME_NONE &&
+      abs(positionError) > m_maxPositionError) {
+    m_maxPositionError = abs(positionError);
+  }
 
-      break;
+  if (m_config.mode == GlobalMotionMode::DISABLED) {
+    return;
   }
-}
 
-int Leadscrew::getPositionError() {
-  return getExpectedPosition() - getCurrentPosition();
+  // when the spindle slows down to reverse, ramp down to where it turns
+  // rather than reacting once it has and running past it
+  int64_t leftStop = m_config.leftStopPosition;
+  int64_t rightStop = m_config.rightStopPosition;
+  int64_t turnaround;
+  if (m_config.mode == GlobalMotionMode::ENABLED &&
+      m_resumeState == RESUME_NONE && getTurnaroundPosition(turnaround)) {
+    // only ahead of the carriage, once it's past it follows the spindle back
+    int64_t current = stepsToNm(m_currentSteps);
+    if (m_currentDirection == LeadscrewDirection::RIGHT &&
+        turnaround >= current) {
+      rightStop = min(rightStop, turnaround);
+    } else if (m_currentDirection == LeadscrewDirection::LEFT &&
+               turnaround <= current) {
+      leftStop = max(leftStop, turnaround);
+    }
+  }
+  stepTowardsExpectedPosition(leftStop, rightStop);
 }
 
-LeadscrewDirection Leadscrew::getCurrentDirection() {
-  return m_currentDirection;
-}
+int Leadscrew::getMaxPositionError() { return m_maxPositionError; }
 
-float Leadscrew::getEstimatedVelocityInMillimetersPerSecond() {
-  return (getEstimatedVelocityInPulsesPerSecond() * leadscrewPitch) /
-         motorPulsePerRevolution;
+void Leadscrew::resetMaxPositionError() {
+  m_maxPositionError = 0;
+  resetMaxFollowingError();
 }
 
 void Leadscrew::printState() {
@@ -303,16 +640,18 @@ void Leadscrew::printState() {
   Serial.println(getCurrentPosition());
   Serial.print("Leadscrew expected position: ");
   Serial.println(getExpectedPosition());
-  Serial.print("Leadscrew left stop position: ");
+  Serial.print("Leadscrew position nm: ");
+  Serial.println(getCurrentPositionNm());
+  Serial.print("Leadscrew left stop position nm: ");
   Serial.println(getStopPosition(Leadscrew::StopPosition::LEFT));
-  Serial.print("Leadscrew right stop position: ");
+  Serial.print("Leadscrew right stop position nm: ");
   Serial.println(getStopPosition(Leadscrew::StopPosition::RIGHT));
   Serial.print("Leadscrew ratio: ");
   Serial.println(getRatio());
-  Serial.print("Leadscrew accumulator unit:");
-  Serial.println(getAccumulatorUnit());
-  Serial.print("Current leadscrew accumulator: ");
-  Serial.println(m_accumulator);
+  Serial.print("Leadscrew thread start: ");
+  Serial.print(getThreadStart());
+  Serial.print(" of ");
+  Serial.println(getThreadStarts());
   Serial.print("Leadscrew direction: ");
   switch (getCurrentDirection()) {
     case LeadscrewDirection::LEFT:
@@ -332,7 +671,12 @@ void Leadscrew::printState() {
   Serial.print("Leadscrew estimated velocity: ");
   Serial.println(getEstimatedVelocityInMillimetersPerSecond());
   Serial.print("Leadscrew pulses to stop: ");
-  Serial.println(calculate_pulses_to_stop(
-      m_currentPulseDelay, initialPulseDelay, pulseDelayIncrement));
+  Serial.println(getPulsesToStop());
+  if (m_feedback != nullptr) {
+    Serial.print("Leadscrew following error: ");
+    Serial.println(getFollowingError());
+    Serial.print("Leadscrew max following error: ");
+    Serial.println(getMaxFollowingError());
+  }
   #endif
 }
@@ -1,68 +1,201 @@
+#include <globalstate.h>
+#include <handwheel.h>
+#include <seqlock.h>
 #include <spindle.h>
-#include <els_elapsedMillis.h>
+#include <clock.h>
+#include <gearbox.h>
+#include <stepper_axis.h>
 
-#include "leadscrew_io.h"
+#include "motion_config.h"
 #pragma once
 
-enum LeadscrewStopState { SET, UNSET };
-enum LeadscrewDirection { LEFT = -1, RIGHT = 1, UNKNOWN = 0 };
-
-class Leadscrew : public LinearAxis, public DerivedAxis, public DrivenAxis {
+class Leadscrew : public StepperAxis, public DerivedAxis {
  private:
   Spindle* m_spindle;
-  LeadscrewIO* m_io;
 
-  float m_expectedPosition;
+  // the config as the main loop last set it, only touched by the main loop
+  MotionConfig m_pendingConfig;
+  SeqLock<MotionConfig> m_publishedConfig;
+  // the snapshot update() is working with, only touched by update()
+  MotionConfig m_config;
+
+  void publishConfig();
+  // pick up the latest published config, call once at the start of update()
+  void readConfig();
+  // set by the main loop whenever it publishes, so a parked leadscrew wakes
+  volatile bool m_configChanged;
+  // getNextUpdateMicros() let the scheduler skip the leadscrew, the timers
+  // kept running since the last update
+  bool m_parked;
+
+  // the spindle position accumulated over all consumed pulses
+  int64_t m_spindleCount;
+  // spindle counts in, nm out, the numerator is the ratio in nm per revolution
+  // update() is actually running with. A new ratio from the config is queued
+  // until the spindle reaches a safe point
+  Gearbox m_gearbox;
+
+  /**
+   * The gearbox of the thread being cut, kept while the leadscrew is disabled
+   * so the next pass picks the same thread up again. It is kept for start 0,
+   * the running gearbox is offset from it by m_threadStartOffset spindle
+   * counts for the start being cut
+   */
+  Gearbox m_threadPhase;
+  bool m_threadPhaseValid;
+  int64_t m_threadStartOffset;
+  uint32_t m_threadGeneration;
+  GlobalMotionMode m_previousMode;
+
+  // spindle counts start k of N is offset by, k/N of a revolution
+  int64_t getThreadStartOffset();
+  // move the gearbox by whole turns of the thread so its output is as close
+  // to the position as it gets
+  void alignToTurn(Gearbox& gearbox, int64_t position);
+  // called when the leadscrew is enabled and disabled
+  void engage();
+  void disengage();
+
+  /**
+   * Feed hold, the carriage ramps down while the gearbox keeps following the
+   * spindle. On resume the carriage waits until the thread comes round to
+   * where a ramp up from standstill ends up on it at full speed
+   */
+  enum ResumeState { RESUME_NONE, RESUME_WAITING, RESUME_MERGING };
+  ResumeState m_resumeState;
+  // where the carriage ramps down to in nm
+  int64_t m_holdPosition;
+  // +1 or -1, which way the spindle last turned
+  int m_spindleDirection;
+  // the carriage speed to merge at in nm/s, signed, and the ramp up to it in
+  // nm/s^2
+  float m_resumeSpeed;
+  float m_resumeAccel;
+  // how far the thread still has to come round before the ramp can start,
+  // from the previous tick
+  int64_t m_resumeLead;
+  elapsedMicros64 m_resumeTimer;
 
-  // the ratio of how much the leadscrew moves per spindle rotation
-  const int motorPulsePerRevolution;
-  const float leadscrewPitch;
-  float m_ratio;
+  void hold();
+  void startResume();
+  // the position to chase while resuming from a hold
+  int64_t updateResume();
 
-  // The current delay between pulses in microseconds
-  const float initialPulseDelay;
-  const float pulseDelayIncrement;
-  float m_currentPulseDelay;
-  LeadscrewDirection m_currentDirection;
+  // account for the spindle movement and apply a queued ratio change
+  void updateRatio(int spindleDelta);
+
+  // the spindle's speed in counts/s and how quickly it is changing in
+  // counts/s^2, measured over windows of ELS_SPINDLE_DECEL_WINDOW_US
+  float m_spindleSpeed;
+  float m_spindleAccel;
+  int64_t m_spindleWindowCount;
+  elapsedMicros64 m_spindleWindowTimer;
+  void updateSpindleSpeed();
+  // no counts over the last window or since
+  bool isSpindleStopped();
+  /**
+   * Where the carriage gets to in nm when the spindle that is slowing down
+   * comes to a stop to reverse, false if it isn't slowing down
+   */
+  bool getTurnaroundPosition(int64_t& position);
 
-  float m_accumulator;
+  // restart the gearbox from the given position at the current spindle count
+  void rebaseExpectedPosition(int64_t position);
 
-  // we may want more sophisticated control over positions, but for now this is
-  // fine
-  LeadscrewStopState m_leftStopState;
-  int m_leftStopPosition;
-  LeadscrewStopState m_rightStopState;
-  int m_rightStopPosition;
+  // the largest position error seen while synced since the last reset
+  int m_maxPositionError;
 
+  // jogging is a velocity command from the main loop that is executed here,
+  // speeds are in mm/s and signed by direction
+  volatile float m_jogTargetSpeed;
+  float m_jogSpeed;
+  // fraction of a nm the jog has moved so far
+  float m_jogProgress;
   /**
-   * This gets the "unit" of the accumulator, i.e the amount the accumulator
-   * increased by when the leadscrew position increases by 1
+   * Fixed distance jogs as running totals in nm, requested is only written by
+   * the main loop and started only by the timer so neither has to lock. They
+   * are 32 bits so they are read in one go and wrap around, only the
+   * difference between them means anything
    */
-  float getAccumulatorUnit();
-  bool sendPulse();
-  // int getStoppingDistanceInPulses();
+  volatile uint32_t m_jogRequestedNm;
+  volatile uint32_t m_jogStartedNm;
+  // the jog distance the timer hasn't started yet in nm
+  int32_t getPendingJogNm();
+  elapsedMicros64 m_jogTimer;
+
+  Handwheel* m_handwheel;
+  volatile bool m_handwheelEnabled;
+
+  void updateJog();
+  void updateHandwheel();
 
  public:
-  Leadscrew(Spindle* spindle, LeadscrewIO* io, float initialPulseDelay,
+  Leadscrew(Spindle* spindle, StepperIO* io, float initialPulseDelay,
             float pulseDelayIncrement, int motorPulsePerRevolution,
             float leadscrewPitch);
-  int getCurrentPosition();
-  void resetCurrentPosition();
+
+  /**
+   * The motion mode the leadscrew timer runs in, this and the other setters
+   * below are called from the main loop and handed to the timer atomically
+   */
+  void setMotionMode(GlobalMotionMode mode);
 
   enum StopPosition { LEFT, RIGHT };
-  void setStopPosition(StopPosition position, int stopPosition);
+  // stop positions are in nm
+  void setStopPosition(StopPosition position, int64_t stopPosition);
   LeadscrewStopState getStopPositionState(StopPosition position);
   void unsetStopPosition(StopPosition position);
-  int getStopPosition(StopPosition position);
+  int64_t getStopPosition(StopPosition position);
+  /**
+   * Set the speed to jog at in mm/s, negative jogs left and 0 stops the jog.
+   * The speed is ramped to by the timer, so it can be called whenever
+   */
+  void setJogSpeed(float mmPerSecond);
+  /**
+   * Attach a handwheel, its steps are executed while jogging and dropped
+   * while it isn't enabled
+   */
+  void setHandwheel(Handwheel* handwheel);
+  void setHandwheelEnabled(bool enabled);
+  // move by a fixed distance in mm, negative moves left
+  void jogDistance(float mm);
+  // true until every jog command has been executed and the leadscrew is back
+  // in position
+  bool isJogging();
   void setRatio(float ratio);
   float getRatio();
-  int getExpectedPosition();
-  void setCurrentPosition(int position);
-  void incrementCurrentPosition(int amount);
-  void update();
-  int getPositionError();
-  LeadscrewDirection getCurrentDirection();
-  float getEstimatedVelocityInMillimetersPerSecond();
+
+  /**
+   * While thread sync is on the leadscrew engages in phase with the thread
+   * the previous passes cut, it moves by up to half a pitch to get onto it.
+   * Otherwise every pass starts from wherever the carriage is
+   */
+  void setThreadSync(bool sync);
+  /**
+   * Cut start k of an N start thread, the sync point is moved by k/N of a
+   * revolution. Picked up the next time the leadscrew is enabled
+   */
+  void setThreadStart(int start, int starts);
+  int getThreadStart();
+  int getThreadStarts();
+  // forget the thread, the next pass starts a new one
+  void resetThreadPhase();
+
+  void update() override;
+  /**
+   * Every tick while it follows the spindle or a jog, the next step edge while
+   * it only has to catch up to where it should be. Once everything has settled
+   * it is idle until the spindle turns, the handwheel or a jog moves it or the
+   * main loop publishes a change
+   */
+  uint64_t getNextUpdateMicros() override;
+  /**
+   * The largest absolute position error while in sync with the spindle since
+   * the last reset, i.e over the current/last pass
+   */
+  int getMaxPositionError();
+  // resets the max following error along with it
+  void resetMaxPositionError();
 
   void printState();
 };
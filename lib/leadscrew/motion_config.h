@@ -0,0 +1,58 @@
+#include <globalstate.h>
+
+#include <cstdint>
+
+#pragma once
+
+// positions are 64 bit integers in nanometres, fine enough that rounding never
+// adds up to anything and big enough that they never overflow
+#define NM_PER_MM 1000000
+
+enum LeadscrewStopState { SET, UNSET };
+
+/**
+ * Everything the leadscrew timer needs from the main loop, published as one
+ * block so the timer never sees half of a change
+ */
+struct MotionConfig {
+  GlobalMotionMode mode;
+
+  // how much the leadscrew moves per spindle rotation in mm, as set
+  float ratio;
+  // the same in nm, which is what the timer works with
+  int64_t ratioNm;
+
+  // stop positions in nm
+  LeadscrewStopState leftStopState;
+  int64_t leftStopPosition;
+  LeadscrewStopState rightStopState;
+  int64_t rightStopPosition;
+
+  // engage in phase with the thread cut by the previous passes
+  bool threadSync;
+  // which start of a multi-start thread is being cut, 0 to threadStarts - 1
+  int threadStart;
+  int threadStarts;
+  // bumped to forget the thread and start a new one on the next pass
+  uint32_t threadGeneration;
+};
+
+/**
+ * The machine dependent numbers the timer works with, worked out once from the
+ * machine profile so the timer only has to multiply and divide by them
+ */
+struct MotionConstants {
+  int spindlePulsePerRevolution;
+  int motorPulsePerRevolution;
+  // mm and nm the leadscrew moves per turn of the motor
+  float leadscrewPitch;
+  int64_t leadscrewPitchNm;
+  // the ramp, see LEADSCREW_INITIAL_PULSE_DELAY_US
+  float initialPulseDelay;
+  float pulseDelayIncrement;
+  // jogging in mm/s and mm/s^2
+  float maxJogSpeed;
+  float jogAccel;
+  // motor steps lost to slack in the screw and nut whenever the motor reverses
+  int backlashSteps;
+};
@@ -0,0 +1,220 @@
+#include "machine_profile.h"
+
+#include <config.h>
+#include <config_checks.h>
+#include <storage_layout.h>
+
+#include <cmath>
+#include <cstring>
+
+MachineProfile MachineProfile::defaults() {
+  MachineProfile profile;
+  profile.spindlePulsePerRevolution = ELS_SPINDLE_ENCODER_PPR;
+  profile.motorPulsePerRevolution = ELS_LEADSCREW_STEPPER_PPR;
+  profile.leadscrewPitch = ELS_LEADSCREW_PITCH_MM;
+  profile.leadscrewAccel = LEADSCREW_ACCEL;
+  profile.leadscrewJerk = LEADSCREW_JERK;
+  profile.jogSpeed = JOG_SPEED;
+  profile.leadscrewBacklash = ELS_LEADSCREW_BACKLASH_MM;
+  return profile;
+}
+
+const char* MachineProfile::validate() const {
+  // written as !(x > 0) so NaNs from a bad edit are caught too
+  if (spindlePulsePerRevolution == 0 || motorPulsePerRevolution == 0) {
+    return "pulses per revolution must be above 0";
+  }
+  if (!(leadscrewPitch > 0) || !(leadscrewAccel > 0) ||
+      !(leadscrewJerk > 0) || !(jogSpeed > 0)) {
+    return "pitch, accel, jerk and jog speed must be above 0";
+  }
+  if (!(leadscrewBacklash >= 0)) {
+    return "backlash can't be negative";
+  }
+
+  float stepsPerMm = motorPulsePerRevolution / leadscrewPitch;
+  if (ConfigChecks::stepRateFor(ConfigChecks::maxFeedPitchMm(),
+                                ELS_FEED_MAX_RPM,
+                                stepsPerMm) > LEADSCREW_MAX_STEP_RATE) {
+    return "the coarsest feed at ELS_FEED_MAX_RPM is too fast to step";
+  }
+  if (ConfigChecks::stepRateFor(ConfigChecks::maxThreadPitchMm(),
+                                ELS_THREAD_MAX_RPM,
+                                stepsPerMm) > LEADSCREW_MAX_STEP_RATE) {
+    return "the coarsest thread at ELS_THREAD_MAX_RPM is too fast to step";
+  }
+  int spindleCounts = spindlePulsePerRevolution * ELS_SPINDLE_INTERPOLATION;
+  if (ConfigChecks::spindleCountsPerTick(ELS_FEED_MAX_RPM, spindleCounts) >=
+      spindleCounts) {
+    return "the spindle turns more than a revolution per timer tick";
+  }
+  if (jogSpeed * stepsPerMm > LEADSCREW_MAX_STEP_RATE) {
+    return "the jog speed is too fast to step";
+  }
+
+#ifndef ACCEL_DISABLED
+  MotionConstants constants = getMotionConstants();
+  if (constants.initialPulseDelay < 2 * LEADSCREW_TIMER_US) {
+    return "jerk is faster than the timer can step";
+  }
+  if (constants.pulseDelayIncrement >= 1) {
+    return "accel is too high for the steps per mm";
+  }
+#ifdef ELS_CROSS_SLIDE_STEP
+  constants = getCrossSlideMotionConstants();
+  if (constants.initialPulseDelay < 2 * LEADSCREW_TIMER_US) {
+    return "jerk is faster than the timer can step the cross slide";
+  }
+  if (constants.pulseDelayIncrement >= 1) {
+    return "accel is too high for the cross slide steps per mm";
+  }
+#endif
+#endif
+
+  return nullptr;
+}
+
+MotionConstants MachineProfile::getMotionConstants() const {
+  float stepsPerMm = motorPulsePerRevolution / leadscrewPitch;
+
+  MotionConstants constants;
+  // the leadscrew works with the interpolated counts
+  constants.spindlePulsePerRevolution =
+      spindlePulsePerRevolution * ELS_SPINDLE_INTERPOLATION;
+  constants.motorPulsePerRevolution = motorPulsePerRevolution;
+  constants.leadscrewPitch = leadscrewPitch;
+  constants.leadscrewPitchNm = llround(leadscrewPitch * NM_PER_MM);
+  // see LEADSCREW_INITIAL_PULSE_DELAY_US and LEADSCREW_PULSE_DELAY_STEP_US
+#ifdef ACCEL_DISABLED
+  constants.initialPulseDelay = 0;
+  constants.pulseDelayIncrement = 0;
+#else
+  constants.initialPulseDelay = US_PER_SECOND / (leadscrewJerk * stepsPerMm);
+  constants.pulseDelayIncrement = leadscrewAccel / stepsPerMm;
+#endif
+  constants.maxJogSpeed = jogSpeed;
+  constants.jogAccel = leadscrewAccel;
+  constants.backlashSteps = lround(leadscrewBacklash * stepsPerMm);
+  return constants;
+}
+
+MotionConstants MachineProfile::getCrossSlideMotionConstants() const {
+  MachineProfile crossSlide = *this;
+  crossSlide.motorPulsePerRevolution = ELS_CROSS_SLIDE_STEPPER_PPR;
+  crossSlide.leadscrewPitch = ELS_CROSS_SLIDE_PITCH_MM;
+  crossSlide.leadscrewBacklash = 0;
+  return crossSlide.getMotionConstants();
+}
+
+static const char* const fieldNames[MachineProfile::FIELD_COUNT] = {
+    "spindle_ppr", "stepper_ppr", "pitch", "accel", "jerk", "jog_speed",
+    "backlash"};
+
+const char* MachineProfile::getFieldName(int field) {
+  if (field < 0 || field >= FIELD_COUNT) {
+    return nullptr;
+  }
+  return fieldNames[field];
+}
+
+float MachineProfile::getField(int field) const {
+  switch (field) {
+    case 0:
+      return spindlePulsePerRevolution;
+    case 1:
+      return motorPulsePerRevolution;
+    case 2:
+      return leadscrewPitch;
+    case 3:
+      return leadscrewAccel;
+    case 4:
+      return leadscrewJerk;
+    case 5:
+      return jogSpeed;
+    case 6:
+      return leadscrewBacklash;
+  }
+  return 0;
+}
+
+bool MachineProfile::setField(const char* name, float value) {
+  int field = 0;
+  while (field < FIELD_COUNT && strcmp(name, fieldNames[field]) != 0) {
+    field++;
+  }
+
+  switch (field) {
+    case 0:
+    case 1:
+      if (!(value >= 0 && value <= UINT16_MAX)) {
+        return false;
+      }
+      if (field == 0) {
+        spindlePulsePerRevolution = value;
+      } else {
+        motorPulsePerRevolution = value;
+      }
+      return true;
+    case 2:
+      leadscrewPitch = value;
+      return true;
+    case 3:
+      leadscrewAccel = value;
+      return true;
+    case 4:
+      leadscrewJerk = value;
+      return true;
+    case 5:
+      jogSpeed = value;
+      return true;
+    case 6:
+      leadscrewBacklash = value;
+      return true;
+  }
+  return false;
+}
+
+int MachineProfile::encode(uint8_t* buffer) const {
+  BinaryWriter writer(buffer);
+  writer.writeU16(spindlePulsePerRevolution);
+  writer.writeU16(motorPulsePerRevolution);
+  writer.writeFloat(leadscrewPitch);
+  writer.writeFloat(leadscrewAccel);
+  writer.writeFloat(leadscrewJerk);
+  writer.writeFloat(jogSpeed);
+  writer.writeFloat(leadscrewBacklash);
+  return writer.getLength();
+}
+
+bool MachineProfile::decode(const uint8_t* buffer, int length) {
+  BinaryReader reader(buffer, length);
+  MachineProfile decoded;
+  decoded.spindlePulsePerRevolution = reader.readU16();
+  decoded.motorPulsePerRevolution = reader.readU16();
+  decoded.leadscrewPitch = reader.readFloat();
+  decoded.leadscrewAccel = reader.readFloat();
+  decoded.leadscrewJerk = reader.readFloat();
+  decoded.jogSpeed = reader.readFloat();
+  decoded.leadscrewBacklash = reader.readFloat();
+  if (!reader.isValid()) {
+    return false;
+  }
+
+  *this = decoded;
+  return true;
+}
+
+MachineProfileStore::MachineProfileStore(StorageIO* io)
+    : m_block(io, STORAGE_MACHINE_PROFILE_ADDRESS, MACHINE_PROFILE_MAGIC,
+              MACHINE_PROFILE_VERSION) {}
+
+bool MachineProfileStore::load(MachineProfile& profile) {
+  uint8_t payload[STORAGE_MACHINE_PROFILE_SIZE - StorageBlock::OVERHEAD];
+  int length = m_block.load(payload, sizeof(payload));
+  return length >= 0 && profile.decode(payload, length);
+}
+
+void MachineProfileStore::save(const MachineProfile& profile) {
+  uint8_t payload[STORAGE_MACHINE_PROFILE_SIZE - StorageBlock::OVERHEAD];
+  m_block.save(payload, profile.encode(payload));
+}
@@ -0,0 +1,73 @@
+#include <motion_config.h>
+#include <storage_block.h>
+#include <storage_io.h>
+
+#include <cstdint>
+
+#pragma once
+
+#define MACHINE_PROFILE_MAGIC 0xE1
+// bump this whenever the encoded layout changes, older profiles are then
+// ignored and the defaults are used until the profile is saved again
+#define MACHINE_PROFILE_VERSION 2
+
+/**
+ * The machine dependent settings that can be changed without reflashing,
+ * everything else in config.h is still compile time
+ */
+struct MachineProfile {
+  uint16_t spindlePulsePerRevolution;
+  uint16_t motorPulsePerRevolution;
+  // mm
+  float leadscrewPitch;
+  // mm/s^2
+  float leadscrewAccel;
+  // the speed the leadscrew can start at from standstill in mm/s
+  float leadscrewJerk;
+  // rapid jog speed in mm/s
+  float jogSpeed;
+  // slack in the leadscrew and half nut in mm, taken up on every reversal
+  float leadscrewBacklash;
+
+  static const int FIELD_COUNT = 7;
+
+  // the values from config.h
+  static MachineProfile defaults();
+
+  /**
+   * Check the machine can do what it is asked to, these are the same checks
+   * config_checks.h does at compile time. Returns nullptr if it can, otherwise
+   * the reason it can't
+   */
+  const char* validate() const;
+  // work out everything the leadscrew timer needs up front
+  MotionConstants getMotionConstants() const;
+  /**
+   * The same for the cross slide, its screw and stepper are still from
+   * config.h but it ramps with the profile's jerk and acceleration
+   */
+  MotionConstants getCrossSlideMotionConstants() const;
+
+  // named access to the fields for the serial console
+  static const char* getFieldName(int field);
+  float getField(int field) const;
+  bool setField(const char* name, float value);
+
+  int encode(uint8_t* buffer) const;
+  bool decode(const uint8_t* buffer, int length);
+};
+
+class MachineProfileStore {
+ private:
+  StorageBlock m_block;
+
+ public:
+  MachineProfileStore(StorageIO* io);
+
+  /**
+   * Load the stored profile, returns false and leaves the profile untouched
+   * if nothing valid was stored
+   */
+  bool load(MachineProfile& profile);
+  void save(const MachineProfile& profile);
+};
@@ -0,0 +1,53 @@
+#include <atomic>
+#include <cstdint>
+
+#pragma once
+
+/**
+ * A sequence lock for handing a block of data from a single writer (the main
+ * loop) to a reader that can interrupt it (a timer callback)
+ *
+ * The writer makes the sequence odd while it is writing. The reader never
+ * waits, since it would be waiting on code it has interrupted; if it catches
+ * a write in progress it keeps using the last value it read instead.
+ *
+ * On the single core Teensy only the compiler has to be kept from reordering
+ * the accesses, so compiler fences are all that's needed
+ */
+template <typename T>
+class SeqLock {
+ private:
+  volatile uint32_t m_sequence;
+  T m_value;
+
+ public:
+  SeqLock() : m_sequence(0), m_value() {}
+  SeqLock(const T& value) : m_sequence(0), m_value(value) {}
+
+  void write(const T& value) {
+    m_sequence = m_sequence + 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    m_value = value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    m_sequence = m_sequence + 1;
+  }
+
+  /**
+   * Copy the value into out, returns false and leaves out untouched if a write
+   * was in progress
+   */
+  bool tryRead(T& out) const {
+    uint32_t sequence = m_sequence;
+    if (sequence & 1) {
+      return false;
+    }
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    T value = m_value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (m_sequence != sequence) {
+      return false;
+    }
+    out = value;
+    return true;
+  }
+};
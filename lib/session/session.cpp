@@ -0,0 +1,143 @@
+#include "session.h"
+
+#include <config.h>
+#include <storage_layout.h>
+
+SessionState SessionState::capture(GlobalState* globalState,
+                                   Leadscrew* leadscrew) {
+  SessionState state;
+  state.feedMode = globalState->getFeedMode();
+  state.unitMode = globalState->getUnitMode();
+  state.feedSelect = globalState->getFeedSelect();
+  state.leftStopState =
+      leadscrew->getStopPositionState(Leadscrew::StopPosition::LEFT);
+  state.leftStopPosition =
+      leadscrew->getStopPosition(Leadscrew::StopPosition::LEFT);
+  state.rightStopState =
+      leadscrew->getStopPositionState(Leadscrew::StopPosition::RIGHT);
+  state.rightStopPosition =
+      leadscrew->getStopPosition(Leadscrew::StopPosition::RIGHT);
+  state.leadscrewPosition = leadscrew->getCurrentPosition();
+  return state;
+}
+
+void SessionState::apply(GlobalState* globalState,
+                         Leadscrew* leadscrew) const {
+  globalState->setMotionMode(GlobalMotionMode::DISABLED);
+  leadscrew->setMotionMode(GlobalMotionMode::DISABLED);
+
+  // the unit mode picks the table the feed select indexes, and the feed mode
+  // resets the select, so the order matters. An out of range select falls
+  // back to the default pitch
+  globalState->setUnitMode(unitMode);
+  globalState->setFeedMode(feedMode);
+  globalState->setFeedSelect(feedSelect);
+  leadscrew->setRatio(globalState->getCurrentFeedPitch());
+
+  leadscrew->setCurrentPosition(leadscrewPosition);
+  if (leftStopState == LeadscrewStopState::SET) {
+    leadscrew->setStopPosition(Leadscrew::StopPosition::LEFT,
+                               leftStopPosition);
+  } else {
+    leadscrew->unsetStopPosition(Leadscrew::StopPosition::LEFT);
+  }
+  if (rightStopState == LeadscrewStopState::SET) {
+    leadscrew->setStopPosition(Leadscrew::StopPosition::RIGHT,
+                               rightStopPosition);
+  } else {
+    leadscrew->unsetStopPosition(Leadscrew::StopPosition::RIGHT);
+  }
+}
+
+int SessionState::encode(uint8_t* buffer) const {
+  BinaryWriter writer(buffer);
+  writer.writeU8(feedMode);
+  writer.writeU8(unitMode);
+  writer.writeU8(feedSelect);
+  writer.writeU8(leftStopState);
+  writer.writeI64(leftStopPosition);
+  writer.writeU8(rightStopState);
+  writer.writeI64(rightStopPosition);
+  writer.writeU32(leadscrewPosition);
+  return writer.getLength();
+}
+
+bool SessionState::decode(const uint8_t* buffer, int length) {
+  BinaryReader reader(buffer, length);
+  uint8_t decodedFeedMode = reader.readU8();
+  uint8_t decodedUnitMode = reader.readU8();
+  uint8_t decodedFeedSelect = reader.readU8();
+  uint8_t decodedLeftStopState = reader.readU8();
+  int64_t decodedLeftStopPosition = reader.readI64();
+  uint8_t decodedRightStopState = reader.readU8();
+  int64_t decodedRightStopPosition = reader.readI64();
+  uint32_t decodedLeadscrewPosition = reader.readU32();
+  if (!reader.isValid() || decodedFeedMode > THREAD ||
+      decodedUnitMode > IMPERIAL || decodedLeftStopState > UNSET ||
+      decodedRightStopState > UNSET) {
+    return false;
+  }
+
+  feedMode = (GlobalFeedMode)decodedFeedMode;
+  unitMode = (GlobalUnitMode)decodedUnitMode;
+  feedSelect = decodedFeedSelect;
+  leftStopState = (LeadscrewStopState)decodedLeftStopState;
+  leftStopPosition = decodedLeftStopPosition;
+  rightStopState = (LeadscrewStopState)decodedRightStopState;
+  rightStopPosition = decodedRightStopPosition;
+  leadscrewPosition = decodedLeadscrewPosition;
+  return true;
+}
+
+bool SessionState::operator==(const SessionState& other) const {
+  return feedMode == other.feedMode && unitMode == other.unitMode &&
+         feedSelect == other.feedSelect &&
+         leftStopState == other.leftStopState &&
+         leftStopPosition == other.leftStopPosition &&
+         rightStopState == other.rightStopState &&
+         rightStopPosition == other.rightStopPosition &&
+         leadscrewPosition == other.leadscrewPosition;
+}
+
+SessionStore::SessionStore(StorageIO* io)
+    : m_block(io, STORAGE_SESSION_ADDRESS, SESSION_MAGIC, SESSION_VERSION),
+      m_savedValid(false),
+      m_pendingValid(false) {}
+
+bool SessionStore::load(SessionState& state) {
+  uint8_t payload[STORAGE_SESSION_SIZE - StorageBlock::OVERHEAD];
+  int length = m_block.load(payload, sizeof(payload));
+  if (length < 0 || !state.decode(payload, length)) {
+    return false;
+  }
+
+  m_saved = state;
+  m_savedValid = true;
+  return true;
+}
+
+void SessionStore::save(const SessionState& state) {
+  uint8_t payload[STORAGE_SESSION_SIZE - StorageBlock::OVERHEAD];
+  m_block.save(payload, state.encode(payload));
+  m_saved = state;
+  m_savedValid = true;
+}
+
+void SessionStore::handle(const SessionState& state) {
+  if (m_savedValid && state == m_saved) {
+    m_pendingValid = false;
+    return;
+  }
+
+  if (!m_pendingValid || !(state == m_pending)) {
+    m_pending = state;
+    m_pendingValid = true;
+    m_pendingTimer = 0;
+    return;
+  }
+
+  if (m_pendingTimer >= ELS_SESSION_SAVE_DELAY_MS) {
+    save(m_pending);
+    m_pendingValid = false;
+  }
+}
@@ -0,0 +1,78 @@
+#include <els_elapsedMillis.h>
+#include <globalstate.h>
+#include <leadscrew.h>
+#include <storage_block.h>
+#include <storage_io.h>
+
+#include <cstdint>
+
+#pragma once
+
+#define SESSION_MAGIC 0x5E
+// bump this whenever the encoded layout changes
+#define SESSION_VERSION 1
+
+/**
+ * What the operator had set up when the machine was turned off, restored on
+ * boot so a job can be picked up where it was left.
+ *
+ * The stops only mean something relative to the leadscrew position, so that is
+ * kept too. It assumes the carriage isn't moved while the power is off, the
+ * same as the stops already did for a running machine
+ */
+struct SessionState {
+  GlobalFeedMode feedMode;
+  GlobalUnitMode unitMode;
+  int feedSelect;
+
+  LeadscrewStopState leftStopState;
+  int64_t leftStopPosition;
+  LeadscrewStopState rightStopState;
+  int64_t rightStopPosition;
+
+  // motor steps
+  int32_t leadscrewPosition;
+
+  static SessionState capture(GlobalState* globalState, Leadscrew* leadscrew);
+  /**
+   * Put the session back, the leadscrew is left disabled whatever it was
+   * doing when the session was saved
+   */
+  void apply(GlobalState* globalState, Leadscrew* leadscrew) const;
+
+  int encode(uint8_t* buffer) const;
+  bool decode(const uint8_t* buffer, int length);
+
+  bool operator==(const SessionState& other) const;
+};
+
+class SessionStore {
+ private:
+  StorageBlock m_block;
+
+  // what is in storage, so unchanged sessions are never written again
+  SessionState m_saved;
+  bool m_savedValid;
+
+  // a change waiting to settle before it is written
+  SessionState m_pending;
+  bool m_pendingValid;
+  elapsedMillis m_pendingTimer;
+
+ public:
+  SessionStore(StorageIO* io);
+
+  /**
+   * Load the stored session, returns false and leaves the state untouched if
+   * nothing valid was stored
+   */
+  bool load(SessionState& state);
+  void save(const SessionState& state);
+
+  /**
+   * Called from the main loop with the current session, it is written once it
+   * has stayed the same for ELS_SESSION_SAVE_DELAY_MS so turning through the
+   * pitches doesn't wear out the EEPROM
+   */
+  void handle(const SessionState& state);
+};
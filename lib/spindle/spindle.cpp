@@ -1,16 +1,18 @@
 #include "spindle.h"
 
+#include <clock.h>
 #include <config.h>
-#include <els_elapsedMillis.h>
 #include <math.h>
 
 #ifndef ELS_SPINDLE_DRIVEN
-Spindle::Spindle(int pinA, int pinB) : m_encoder(pinA, pinB) {
+Spindle::Spindle(int pinA, int pinB)
+    : m_encoder(pinA, pinB), m_interpolator(ELS_SPINDLE_INTERPOLATION) {
 #else
-Spindle::Spindle() {
+Spindle::Spindle() : m_interpolator(ELS_SPINDLE_INTERPOLATION) {
 #endif
 
   m_unconsumedPosition = 0;
+  m_pulsesPerRevolution = ELS_SPINDLE_COUNTS_PER_REV;
   m_lastPulseMicros = 0;
   m_lastFullPulseDurationMicros = 0;
   m_currentPosition = 0;
@@ -19,29 +21,46 @@ Spindle::Spindle() {
 void Spindle::update() {
   // read the encoder and update the current position
   // todo: we should keep the absolute position of the spindle, cbf right now
-  int position = m_encoder.read();
+  int position = m_encoder.readAndReset();
+#if ELS_SPINDLE_INTERPOLATION > 1
+  // a few pulses per revolution are turned into many counts
+  position = m_interpolator.update(position, Clock::tickMicros());
+#endif
   incrementCurrentPosition(position);
-  m_encoder.write(0);
 }
 
 void Spindle::setCurrentPosition(int position) {
-  int newPosition = position % ELS_SPINDLE_ENCODER_PPR;
+  int newPosition = position % m_pulsesPerRevolution;
   m_unconsumedPosition = newPosition - m_currentPosition;
   m_currentPosition = newPosition;
 }
 
 void Spindle::incrementCurrentPosition(int amount) {
+  int unconsumed = m_unconsumedPosition;
   setCurrentPosition(getCurrentPosition() + amount);
+  // the position wraps every revolution, the driven axes need the actual
+  // movement rather than the jump back across the wrap, on top of whatever
+  // they haven't taken yet
+  m_unconsumedPosition = unconsumed + amount;
   if (amount != 0) {
-    m_lastFullPulseDurationMicros = m_lastPulseMicros / abs(amount);
+    // the spindle can sit still for far longer than 32 bits of micros
+    uint64_t duration = m_lastPulseMicros / abs(amount);
+    m_lastFullPulseDurationMicros =
+        duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration;
     m_lastPulseMicros = 0;
   }
 }
 
 float Spindle::getEstimatedVelocityInRPM() {
-  return getEstimatedVelocityInPulsesPerSecond() / ELS_SPINDLE_ENCODER_PPR;
+  return getEstimatedVelocityInPulsesPerSecond() / m_pulsesPerRevolution;
+}
+
+void Spindle::setPulsesPerRevolution(int pulsesPerRevolution) {
+  m_pulsesPerRevolution = pulsesPerRevolution * ELS_SPINDLE_INTERPOLATION;
 }
 
+int Spindle::getPulsesPerRevolution() { return m_pulsesPerRevolution; }
+
 int Spindle::consumePosition() {
   int position = m_unconsumedPosition;
   m_unconsumedPosition = 0;
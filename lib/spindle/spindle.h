@@ -1,6 +1,8 @@
-#include <Encoder.h>
 #include <axis.h>
-#include <els_elapsedMillis.h>
+#include <config.h>
+#include <els_encoder.h>
+
+#include "spindle_interpolator.h"
 
 #pragma once
 
@@ -10,14 +12,22 @@ class Spindle : public RotationalAxis {
   // but hasn't been used to update the current position of any driven axes
   int m_unconsumedPosition;
 
+  int m_pulsesPerRevolution;
+
 #ifndef ELS_SPINDLE_DRIVEN
   Encoder m_encoder;
 #endif
+  // only used with ELS_SPINDLE_INTERPOLATION above 1
+  SpindleInterpolator m_interpolator;
 
  public:
 #ifndef ELS_SPINDLE_DRIVEN
   Spindle(int pinA, int pinB);
 #endif
+#ifdef PIO_UNIT_TESTING
+  // tests move the spindle by setting its position directly
+  Spindle() : Spindle(0, 0) {}
+#endif
 
   void update();
   void setCurrentPosition(int position);
@@ -27,5 +37,12 @@ class Spindle : public RotationalAxis {
    * used for updating the expected position of any driven axes
    */
   int consumePosition();
+  // true if the spindle moved since the last consume
+  bool hasUnconsumedPosition() { return m_unconsumedPosition != 0; }
   float getEstimatedVelocityInRPM();
+
+  // sensor pulses per revolution, defaults to ELS_SPINDLE_ENCODER_PPR
+  void setPulsesPerRevolution(int pulsesPerRevolution);
+  // counts per revolution, the pulses times ELS_SPINDLE_INTERPOLATION
+  int getPulsesPerRevolution();
 };
\ No newline at end of file
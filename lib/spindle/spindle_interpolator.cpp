@@ -0,0 +1,69 @@
+#include "spindle_interpolator.h"
+
+#include <cstdlib>
+
+// the most the period is assumed to change from one pulse to the next
+#define MAX_PERIOD_CHANGE 2.0f
+
+SpindleInterpolator::SpindleInterpolator(int countsPerPulse)
+    : m_countsPerPulse(countsPerPulse),
+      m_pulses(0),
+      m_pulseMicros(0),
+      m_direction(0),
+      m_period(0),
+      m_previousPeriod(0),
+      m_predictedPeriod(0),
+      m_counts(0) {}
+
+float SpindleInterpolator::predictPeriod() {
+  if (m_period == 0) {
+    return 0;
+  }
+  if (m_previousPeriod == 0) {
+    return m_period;
+  }
+
+  // the spindle changes speed by about as much again over the next pulse
+  float change = (float)m_period / m_previousPeriod;
+  if (change > MAX_PERIOD_CHANGE) {
+    change = MAX_PERIOD_CHANGE;
+  } else if (change < 1 / MAX_PERIOD_CHANGE) {
+    change = 1 / MAX_PERIOD_CHANGE;
+  }
+  return m_period * change;
+}
+
+int SpindleInterpolator::update(int pulses, uint64_t micros) {
+  if (pulses != 0) {
+    int direction = pulses > 0 ? 1 : -1;
+    if (direction == m_direction) {
+      m_previousPeriod = m_period;
+      m_period = (micros - m_pulseMicros) / abs(pulses);
+    } else {
+      // the first pulse, or the spindle turned around, there's no period to
+      // go by until the next one
+      m_previousPeriod = 0;
+      m_period = 0;
+    }
+    m_direction = direction;
+    m_pulses += pulses;
+    m_pulseMicros = micros;
+    m_predictedPeriod = predictPeriod();
+  }
+
+  // every count up to the last pulse, then as far into the next one as the
+  // time since says
+  int64_t target = m_pulses * m_countsPerPulse;
+  if (m_predictedPeriod > 0) {
+    float progress = (micros - m_pulseMicros) / m_predictedPeriod;
+    int64_t counts = (int64_t)(progress * m_countsPerPulse);
+    if (counts > m_countsPerPulse - 1) {
+      counts = m_countsPerPulse - 1;
+    }
+    target += m_direction * counts;
+  }
+
+  int counts = target - m_counts;
+  m_counts = target;
+  return counts;
+}
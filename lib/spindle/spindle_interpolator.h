@@ -0,0 +1,44 @@
+#include <cstdint>
+
+#pragma once
+
+/**
+ * Splits the pulses of a low resolution spindle sensor into evenly timed
+ * virtual counts
+ *
+ * The period of the last pulse, scaled by how much it changed from the one
+ * before so a spindle that is speeding up or slowing down is followed,
+ * predicts when the next pulse is due and the counts in between are handed
+ * out on that schedule. The counts never run past the next real pulse, if the
+ * spindle is slower than predicted they wait for it, so they are never more
+ * than a pulse away from the sensor
+ */
+class SpindleInterpolator {
+ private:
+  const int m_countsPerPulse;
+
+  // the real pulses so far and the Clock time of the last one
+  int64_t m_pulses;
+  uint64_t m_pulseMicros;
+  // +1 or -1, which way the last pulse went
+  int m_direction;
+  // the periods of the last two pulses in us, 0 if they aren't known
+  uint64_t m_period;
+  uint64_t m_previousPeriod;
+  // how long the pulse under way should take in us, 0 to wait for it
+  float m_predictedPeriod;
+
+  // the virtual counts handed out so far
+  int64_t m_counts;
+
+  float predictPeriod();
+
+ public:
+  explicit SpindleInterpolator(int countsPerPulse);
+
+  /**
+   * Take the real pulses since the last call at the given Clock time, returns
+   * the virtual counts to move by
+   */
+  int update(int pulses, uint64_t micros);
+};
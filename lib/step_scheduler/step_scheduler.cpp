@@ -0,0 +1,36 @@
+#include "step_scheduler.h"
+
+#include <clock.h>
+
+StepScheduler::StepScheduler() : m_axisCount(0), m_nextDeadline(0) {}
+
+bool StepScheduler::addAxis(DrivenAxis* axis) {
+  if (m_axisCount >= STEP_SCHEDULER_MAX_AXES) {
+    return false;
+  }
+  m_axes[m_axisCount++] = axis;
+  return true;
+}
+
+int StepScheduler::getAxisCount() { return m_axisCount; }
+
+void StepScheduler::update() {
+  uint64_t now = Clock::tickMicros();
+  uint64_t nextDeadline = UINT64_MAX;
+
+  for (int i = 0; i < m_axisCount; i++) {
+    DrivenAxis* axis = m_axes[i];
+    uint64_t deadline = axis->getNextUpdateMicros();
+    if (deadline <= now) {
+      axis->update();
+      deadline = axis->getNextUpdateMicros();
+    }
+    if (deadline < nextDeadline) {
+      nextDeadline = deadline;
+    }
+  }
+
+  m_nextDeadline = nextDeadline;
+}
+
+uint64_t StepScheduler::getNextDeadline() { return m_nextDeadline; }
@@ -0,0 +1,40 @@
+#include <axis.h>
+
+#include <cstdint>
+
+#pragma once
+
+// the most driven axes one scheduler can serve
+#define STEP_SCHEDULER_MAX_AXES 4
+
+/**
+ * Serves every driven axis from the one leadscrew timer
+ *
+ * Each tick the axes whose next deadline has come are updated, the rest are
+ * skipped, so an axis that is standing still costs one comparison per tick
+ * rather than a timer of its own. The earliest deadline over all the axes is
+ * when the timer next has to run, it is set to wake then rather than polling
+ */
+class StepScheduler {
+ private:
+  DrivenAxis* m_axes[STEP_SCHEDULER_MAX_AXES];
+  int m_axisCount;
+  volatile uint64_t m_nextDeadline;
+
+ public:
+  StepScheduler();
+
+  /**
+   * Add an axis to be served, only before the timer is started. Returns false
+   * if there is no room for it
+   */
+  bool addAxis(DrivenAxis* axis);
+  int getAxisCount();
+
+  // called from the timer
+  void update();
+
+  // the earliest Clock time any axis has to be updated by, see
+  // DrivenAxis::getNextUpdateMicros
+  uint64_t getNextDeadline();
+};
@@ -0,0 +1,14 @@
+#include <cstdint>
+
+#pragma once
+
+/**
+ * The HW interface for a position feedback encoder on an axis, a linear scale
+ * on the carriage or an encoder on the leadscrew, abstracted like StepperIO so
+ * the tests can drive it
+ */
+class FeedbackIO {
+ public:
+  // quadrature counts since power on, positive is to the right
+  virtual int32_t readCounts() = 0;
+};
@@ -0,0 +1,14 @@
+#include <els_encoder.h>
+
+#include "feedback_io.h"
+#pragma once
+
+// the encoder library counts on pin interrupts, reading it is just a load
+template <int pinA, int pinB>
+class FeedbackIOImpl : public FeedbackIO {
+  Encoder m_encoder;
+
+ public:
+  FeedbackIOImpl() : m_encoder(pinA, pinB) {}
+  inline int32_t readCounts() { return m_encoder.read(); }
+};
@@ -0,0 +1,29 @@
+#include <cstdint>
+
+#pragma once
+
+/**
+ * An integer electronic gearbox
+ *
+ * output = output origin + (input - input origin) * numerator / denominator
+ *
+ * The output is always worked out from the origin rather than added up tick
+ * by tick, so the rounding of the division never accumulates. Re-base it
+ * whenever the ratio changes or the output is moved by something else
+ */
+struct Gearbox {
+  int64_t inputOrigin;
+  int64_t outputOrigin;
+  int64_t numerator;
+  int64_t denominator;
+
+  int64_t output(int64_t input) const {
+    return outputOrigin + (input - inputOrigin) * numerator / denominator;
+  }
+
+  // carry on from output at input
+  void rebase(int64_t input, int64_t output) {
+    inputOrigin = input;
+    outputOrigin = output;
+  }
+};
@@ -0,0 +1,419 @@
+#include "stepper_axis.h"
+
+#include <config.h>
+
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+#ifdef PIO_UNIT_TESTING
+#define __disable_irq()
+#define __enable_irq()
+#endif
+
+StepperAxis::StepperAxis(StepperIO* io, float initialPulseDelay,
+                         float pulseDelayIncrement,
+                         int motorPulsePerRevolution, float pitch)
+    : m_io(io),
+      m_expectedPosition(0),
+      m_currentSteps(0),
+      m_currentPulseDelay(initialPulseDelay),
+      m_minPulseDelay(0),
+      m_currentDirection(LeadscrewDirection::UNKNOWN),
+      m_pulseDirection(LeadscrewDirection::UNKNOWN),
+      m_backlashRemaining(0),
+      m_feedback(nullptr),
+      m_feedbackCountsPerMm(1),
+      m_feedbackOrigin(0),
+      m_followingError(0),
+      m_maxFollowingError(0),
+      m_correctedSteps(0),
+      m_feedbackFault(false),
+      m_lastFeedbackCounts(0) {
+  m_constants.spindlePulsePerRevolution = ELS_SPINDLE_COUNTS_PER_REV;
+  m_constants.motorPulsePerRevolution = motorPulsePerRevolution;
+  m_constants.leadscrewPitch = pitch;
+  m_constants.leadscrewPitchNm = llround(pitch * NM_PER_MM);
+  m_constants.initialPulseDelay = initialPulseDelay;
+  m_constants.pulseDelayIncrement = pulseDelayIncrement;
+  m_constants.maxJogSpeed = JOG_SPEED;
+  m_constants.jogAccel = JOG_ACCEL;
+  m_constants.backlashSteps = 0;
+
+  m_lastPulseMicros = 0;
+  m_lastFullPulseDurationMicros = 0;
+}
+
+void StepperAxis::setDirection(LeadscrewDirection direction) {
+  m_currentDirection = direction;
+  uint8_t pinState = direction == LeadscrewDirection::RIGHT ? 1 : 0;
+  if (m_io->readDirPin() != pinState) {
+    m_io->writeDirPin(pinState);
+    m_dirSetupTimer = 0;
+  }
+}
+
+int64_t StepperAxis::readFromLoop(volatile int64_t& value) {
+  int64_t result;
+  do {
+    result = value;
+  } while (result != value);
+  return result;
+}
+
+int64_t StepperAxis::nmToSteps(int64_t nm) {
+  int64_t scaled = nm * m_constants.motorPulsePerRevolution;
+  int64_t half = m_constants.leadscrewPitchNm / 2;
+  return (scaled >= 0 ? scaled + half : scaled - half) /
+         m_constants.leadscrewPitchNm;
+}
+
+int64_t StepperAxis::stepsToNm(int64_t steps) {
+  return steps * m_constants.leadscrewPitchNm /
+         m_constants.motorPulsePerRevolution;
+}
+
+void StepperAxis::setMotionConstants(const MotionConstants& constants) {
+  // the timer reads these every tick, it can't see half of them
+  __disable_irq();
+  m_constants = constants;
+  m_currentPulseDelay = constants.initialPulseDelay;
+  // the slack is assumed to be taken up in whichever way the axis moves next
+  m_backlashRemaining = 0;
+  __enable_irq();
+}
+
+const MotionConstants& StepperAxis::getMotionConstants() {
+  return m_constants;
+}
+
+void StepperAxis::setMinPulseDelay(float minPulseDelay) {
+  m_minPulseDelay = minPulseDelay;
+}
+
+void StepperAxis::setFeedback(FeedbackIO* feedback, int countsPerMm) {
+  m_feedbackCountsPerMm = countsPerMm;
+  m_feedback = feedback;
+  // wherever the axis is now is where the feedback counts from
+  m_feedbackOrigin = m_currentSteps - getFeedbackSteps();
+}
+
+int64_t StepperAxis::getFeedbackSteps() {
+  m_lastFeedbackCounts = m_feedback->readCounts();
+  return nmToSteps((int64_t)m_lastFeedbackCounts * NM_PER_MM /
+                   m_feedbackCountsPerMm);
+}
+
+bool StepperAxis::hasFeedbackMoved() {
+  return m_feedback != nullptr &&
+         m_feedback->readCounts() != m_lastFeedbackCounts;
+}
+
+bool StepperAxis::checkFeedback() {
+  if (m_feedback == nullptr) {
+    return true;
+  }
+  if (m_feedbackFault) {
+    return false;
+  }
+
+  int64_t measured = m_feedbackOrigin + getFeedbackSteps();
+  int64_t error = measured - m_currentSteps;
+  m_followingError = error;
+  if (abs(m_followingError) > m_maxFollowingError) {
+    m_maxFollowingError = abs(m_followingError);
+  }
+
+  // a stalled motor is corrected over and over, so everything made up on the
+  // way to the target counts towards the fault
+  if (m_currentSteps == nmToSteps(m_expectedPosition)) {
+    m_correctedSteps = 0;
+  }
+  int64_t lostNm = stepsToNm(m_correctedSteps + llabs(error));
+  if (lostNm > ELS_LEADSCREW_FEEDBACK_FAULT_MM * NM_PER_MM) {
+    // something is jammed or the motor stalled, no amount of stepping is going
+    // to fix that. It has to start from standstill once it's cleared. A step
+    // whose edge has gone out is finished first, the pin isn't left high
+    if (m_io->readStepPin() == 1) {
+      m_io->writeStepPin(0);
+      countStep();
+      m_lastPulseMicros = 0;
+    }
+    m_feedbackFault = true;
+    m_currentDirection = LeadscrewDirection::UNKNOWN;
+    m_currentPulseDelay = m_constants.initialPulseDelay;
+    return false;
+  }
+  // not while a step is half sent, the motor has made it but it isn't counted
+  // yet
+  if (llabs(stepsToNm(error)) >
+          ELS_LEADSCREW_FEEDBACK_DEADBAND_MM * NM_PER_MM &&
+      m_io->readStepPin() == 0) {
+    // the lost steps show up as position error, which the ramp makes up like
+    // any other
+    m_currentSteps = measured;
+    m_correctedSteps += llabs(error);
+  }
+  return true;
+}
+
+void StepperAxis::followFeedback() {
+  if (m_feedback == nullptr) {
+    return;
+  }
+  m_currentSteps = m_feedbackOrigin + getFeedbackSteps();
+  m_followingError = 0;
+  m_correctedSteps = 0;
+  m_feedbackFault = false;
+}
+
+int StepperAxis::getFollowingError() { return m_followingError; }
+
+int StepperAxis::getMaxFollowingError() { return m_maxFollowingError; }
+
+void StepperAxis::resetMaxFollowingError() { m_maxFollowingError = 0; }
+
+bool StepperAxis::hasFeedbackFault() { return m_feedbackFault; }
+
+int StepperAxis::getExpectedPosition() {
+  return nmToSteps(readFromLoop(m_expectedPosition));
+}
+
+int StepperAxis::getCurrentPosition() { return readFromLoop(m_currentSteps); }
+
+int64_t StepperAxis::getExpectedPositionNm() {
+  return readFromLoop(m_expectedPosition);
+}
+
+int64_t StepperAxis::getCurrentPositionNm() {
+  return stepsToNm(readFromLoop(m_currentSteps));
+}
+
+// the feedback moves with the position so it keeps reading the same
+void StepperAxis::resetCurrentPosition() {
+  int64_t steps = nmToSteps(m_expectedPosition);
+  m_feedbackOrigin += steps - m_currentSteps;
+  m_currentSteps = steps;
+}
+
+void StepperAxis::setCurrentPosition(int position) {
+  m_feedbackOrigin += position - m_currentSteps;
+  m_currentSteps = position;
+}
+
+void StepperAxis::incrementCurrentPosition(int amount) {
+  m_feedbackOrigin += amount;
+  m_currentSteps += amount;
+}
+
+int StepperAxis::getPositionError() {
+  return nmToSteps(readFromLoop(m_expectedPosition)) -
+         readFromLoop(m_currentSteps);
+}
+
+LeadscrewDirection StepperAxis::getCurrentDirection() {
+  return m_currentDirection;
+}
+
+float StepperAxis::getEstimatedVelocityInMillimetersPerSecond() {
+  return (getEstimatedVelocityInPulsesPerSecond() *
+          m_constants.leadscrewPitch) /
+         m_constants.motorPulsePerRevolution;
+}
+
+void StepperAxis::countStep() {
+  // after a reversal the motor first takes up the slack, the part of it that
+  // was already taken up the other way if it reverses again half way through
+  if (m_pulseDirection != LeadscrewDirection::UNKNOWN &&
+      m_pulseDirection != m_currentDirection) {
+    m_backlashRemaining = m_constants.backlashSteps - m_backlashRemaining;
+  }
+  m_pulseDirection = m_currentDirection;
+  if (m_backlashRemaining > 0) {
+    m_backlashRemaining--;
+  } else {
+    m_currentSteps += m_currentDirection;
+  }
+}
+
+bool StepperAxis::sendPulse() {
+  uint8_t pinState = m_io->readStepPin();
+
+  // Keep the pulse pin high as long as we're not scheduled to send a pulse
+  if (pinState == 1) {
+    m_io->writeStepPin(0);
+
+  } else {
+    m_io->writeStepPin(1);
+  }
+
+  return pinState == 1;
+}
+
+/**
+ * Due to the cumulative nature of the pulses when stopping, we can model the
+ * stopping distance as a quadratic equation.
+ * This function calculates the number of pulses required to stop the leadscrew
+ * from a given pulse delay
+ */
+int calculate_pulses_to_stop(float currentPulseDelay, float initialPulseDelay,
+                             float pulseDelayIncrement) {
+  // Calculate the discriminant
+  float discriminant = currentPulseDelay * currentPulseDelay -
+                       4 * (pulseDelayIncrement / 2.0) * (-initialPulseDelay);
+
+  // Ensure the discriminant is non-negative for real roots
+  if (discriminant >= 0) {
+    // Calculate the square root of the discriminant
+    float sqrtDiscriminant = sqrt(discriminant);
+
+    // Calculate the positive root using the quadratic formula
+    float n =
+        (-currentPulseDelay + sqrtDiscriminant) / (2 * pulseDelayIncrement);
+
+    // Round up to the nearest integer because pulses must be whole numbers
+    return abs((int)ceil(n));
+  } else {
+    // If the discriminant is negative, return 0 as a fallback (no real
+    // solution)
+    return 0;
+  }
+}
+
+int StepperAxis::getPulsesToStop() {
+  return calculate_pulses_to_stop(m_currentPulseDelay,
+                                  m_constants.initialPulseDelay,
+                                  m_constants.pulseDelayIncrement);
+}
+
+uint64_t StepperAxis::getNextEdgeMicros() {
+  // the falling edge is sent on the update after the rising one
+  if (m_io->readStepPin() == 1) {
+    return 0;
+  }
+  uint64_t now = Clock::tickMicros();
+  uint64_t pulseDue =
+      now - (uint64_t)m_lastPulseMicros + (uint64_t)m_currentPulseDelay;
+  uint64_t dirSetupDue =
+      now - (uint64_t)m_dirSetupTimer + ELS_STEPPER_DIR_SETUP_US;
+  return max(pulseDue, dirSetupDue);
+}
+
+void StepperAxis::stepTowardsExpectedPosition(int64_t leftStop,
+                                              int64_t rightStop) {
+  if (!checkFeedback()) {
+    return;
+  }
+
+  int positionError = getPositionError();
+  LeadscrewDirection nextDirection = LeadscrewDirection::UNKNOWN;
+  if (positionError > 0) {
+    nextDirection = LeadscrewDirection::RIGHT;
+  } else if (positionError < 0) {
+    nextDirection = LeadscrewDirection::LEFT;
+  }
+
+  // a step that is half sent is finished the way it was started, the motor
+  // has already made it
+  bool midPulse = m_io->readStepPin() == 1;
+
+  /**
+   * Attempt to find the "next" direction to move in, if the current
+   * direction is unknown i.e: at a standstill - we know we have to start
+   * moving in that direction
+   *
+   * If the next direction is different from the current direction, we
+   * should start decelerating to move in the intended direction, it only
+   * turns once it is down to a speed it could start from standstill at
+   */
+  if (!midPulse) {
+    if (nextDirection == LeadscrewDirection::UNKNOWN) {
+      m_currentDirection = LeadscrewDirection::UNKNOWN;
+      return;
+    }
+    if (nextDirection != m_currentDirection &&
+        (m_currentDirection == LeadscrewDirection::UNKNOWN ||
+         m_currentPulseDelay == m_constants.initialPulseDelay)) {
+      // the target can turn around while the axis sits on it at speed, it
+      // still has to start again from standstill the other way
+      if (m_pulseDirection == -nextDirection) {
+        m_currentPulseDelay = m_constants.initialPulseDelay;
+      }
+      setDirection(nextDirection);
+    }
+  }
+
+  int64_t currentPosition = stepsToNm(m_currentSteps);
+  bool hitEndstop = (currentPosition >= rightStop &&
+                     m_currentDirection == LeadscrewDirection::RIGHT) ||
+                    (currentPosition <= leftStop &&
+                     m_currentDirection == LeadscrewDirection::LEFT);
+
+  // check if we're scheduled for a pulse, the step edge also waits for the
+  // driver to pick up a new direction
+  if (!midPulse && (m_lastPulseMicros < m_currentPulseDelay ||
+                    m_dirSetupTimer < ELS_STEPPER_DIR_SETUP_US || hitEndstop)) {
+    return;
+  }
+
+  // attempt to keep in sync with the expected position
+  // if sendPulse returns true, we've actually sent a pulse
+  if (!sendPulse()) {
+    return;
+  }
+
+  m_lastFullPulseDurationMicros = min((uint64_t)m_lastPulseMicros,
+                                      (uint64_t)m_constants.initialPulseDelay);
+  m_lastPulseMicros = 0;
+
+  countStep();
+
+  // calculate the stopping time
+  int pulsesToStop = getPulsesToStop();
+
+  // how far the stop ahead is, so the axis ramps down into it rather than
+  // running into it at speed
+  int64_t stopDistance = INT64_MAX;
+  if (m_currentDirection == LeadscrewDirection::RIGHT &&
+      rightStop != INT64_MAX) {
+    stopDistance = nmToSteps(rightStop - currentPosition) - 1;
+  } else if (m_currentDirection == LeadscrewDirection::LEFT &&
+             leftStop != INT64_MIN) {
+    stopDistance = nmToSteps(currentPosition - leftStop) - 1;
+  }
+
+  // the slack still to take up is part of the move, its steps are ramped
+  // through like any others
+  int64_t pulsesToTarget = abs(positionError) + m_backlashRemaining;
+  if (stopDistance != INT64_MAX) {
+    stopDistance += m_backlashRemaining;
+  }
+
+  // if this is true we should start decelerating to stop at the
+  // correct position
+  bool shouldStop = pulsesToTarget <= pulsesToStop ||
+                    stopDistance <= pulsesToStop ||
+                    nextDirection != m_currentDirection || hitEndstop;
+
+  float accelChange =
+      m_constants.pulseDelayIncrement * m_lastFullPulseDurationMicros;
+
+  if (shouldStop) {
+    m_currentPulseDelay += accelChange;
+  } else {
+    m_currentPulseDelay -= accelChange;
+  }
+
+  // if pulse is sent we want to calculate how much to change the timing
+  // for the next pulse
+  // depending on accel and current speed etc
+  // inital pulse delay is upper timing limit
+  //
+  if (m_currentPulseDelay > m_constants.initialPulseDelay) {
+    m_currentPulseDelay = m_constants.initialPulseDelay;
+  }
+  if (m_currentPulseDelay < m_minPulseDelay) {
+    m_currentPulseDelay = m_minPulseDelay;
+  }
+}
@@ -0,0 +1,153 @@
+#include <axis.h>
+#include <motion_config.h>
+
+#include <cstdint>
+
+#include "feedback_io.h"
+#include "stepper_io.h"
+#pragma once
+
+enum LeadscrewDirection { LEFT = -1, RIGHT = 1, UNKNOWN = 0 };
+
+/**
+ * A linear axis moved by a stepper motor, it chases an expected position that
+ * the derived class works out every update
+ *
+ * Positions are kept in nm like the leadscrew's, the motor position in steps.
+ * Every driven axis shares the same ramp and stop handling from here
+ */
+class StepperAxis : public LinearAxis, public DrivenAxis {
+ protected:
+  StepperIO* m_io;
+
+  // where the axis should be in nm
+  volatile int64_t m_expectedPosition;
+  // where the axis is in motor steps, steps are what the motor actually does
+  // so this is exact and only converted to nm when compared
+  volatile int64_t m_currentSteps;
+
+  MotionConstants m_constants;
+
+  // The current delay between pulses in microseconds
+  float m_currentPulseDelay;
+  // the ramp doesn't go any faster than this, see setMinPulseDelay()
+  float m_minPulseDelay;
+  LeadscrewDirection m_currentDirection;
+  // the direction the last pulse was sent in, the direction above is dropped
+  // whenever the axis is on target
+  LeadscrewDirection m_pulseDirection;
+  // since the direction pin last changed, the driver needs
+  // ELS_STEPPER_DIR_SETUP_US before the next step edge
+  elapsedMicros64 m_dirSetupTimer;
+  /**
+   * Steps still to send after a reversal before the nut is pushed again, they
+   * turn the motor but don't move the axis so they aren't counted in
+   * m_currentSteps
+   */
+  int m_backlashRemaining;
+
+  /**
+   * Optional position feedback, without it the steps sent are all there is to
+   * go on. With it the steps are compared against where the axis really is
+   * every tick, see ELS_LEADSCREW_FEEDBACK_A
+   */
+  FeedbackIO* m_feedback;
+  int m_feedbackCountsPerMm;
+  // the axis position in steps at feedback count 0
+  int64_t m_feedbackOrigin;
+  // where the feedback says the axis is less where it was stepped to, in steps
+  volatile int m_followingError;
+  int m_maxFollowingError;
+  // steps made up since the axis was last on target
+  int64_t m_correctedSteps;
+  volatile bool m_feedbackFault;
+
+  // the counts the feedback read last time it was checked
+  int32_t m_lastFeedbackCounts;
+
+  int64_t getFeedbackSteps();
+  // true if the feedback moved since it was last checked
+  bool hasFeedbackMoved();
+  /**
+   * Compare the feedback against the steps sent, steps lost beyond the
+   * deadband are taken off the position so the ramp makes them up. Returns
+   * false while the axis is faulted and mustn't be stepped
+   */
+  bool checkFeedback();
+  // take the position from the feedback while nothing drives the axis, this
+  // also clears a fault
+  void followFeedback();
+
+  // convert between motor steps and nm, rounding to the nearest step
+  int64_t nmToSteps(int64_t nm);
+  int64_t stepsToNm(int64_t steps);
+
+  /**
+   * 64 bit values are written in two halves, the main loop reads them twice
+   * so it can't see half of an update from the timer
+   */
+  static int64_t readFromLoop(volatile int64_t& value);
+
+  // the direction pin is only written when it changes, which starts the setup
+  // time
+  void setDirection(LeadscrewDirection direction);
+  bool sendPulse();
+  // account for a step once its pulse is finished, in m_currentDirection
+  void countStep();
+  /**
+   * Ramp towards the expected position, sending at most one edge. The axis
+   * ramps down into the stops (nm) and nothing is sent past them,
+   * INT64_MIN/INT64_MAX if there are none
+   */
+  void stepTowardsExpectedPosition(int64_t leftStop, int64_t rightStop);
+
+ public:
+  StepperAxis(StepperIO* io, float initialPulseDelay, float pulseDelayIncrement,
+              int motorPulsePerRevolution, float pitch);
+
+  /**
+   * Swap in the constants for a different machine profile, only while the
+   * axis isn't moving
+   */
+  void setMotionConstants(const MotionConstants& constants);
+  const MotionConstants& getMotionConstants();
+  /**
+   * Keep the ramp to at most one step per minPulseDelay us, for an axis geared
+   * off this one that needs more steps than it does. 0 for no limit
+   */
+  void setMinPulseDelay(float minPulseDelay);
+
+  // attach a feedback encoder with the given counts per mm of travel
+  void setFeedback(FeedbackIO* feedback, int countsPerMm);
+  // the latest and largest absolute following error in steps, 0 without
+  // feedback
+  int getFollowingError();
+  int getMaxFollowingError();
+  void resetMaxFollowingError();
+  /**
+   * True once the following error went past ELS_LEADSCREW_FEEDBACK_FAULT_MM,
+   * the axis stops stepping until it is disabled
+   */
+  bool hasFeedbackFault();
+
+  // positions in motor steps
+  int getCurrentPosition() override;
+  void resetCurrentPosition() override;
+  void setCurrentPosition(int position) override;
+  void incrementCurrentPosition(int amount) override;
+  int getExpectedPosition() override;
+  int getPositionError() override;
+  // positions in nm
+  int64_t getCurrentPositionNm();
+  int64_t getExpectedPositionNm();
+
+  LeadscrewDirection getCurrentDirection();
+  float getEstimatedVelocityInMillimetersPerSecond() override;
+  // the pulses it would take to ramp down from the current speed
+  int getPulsesToStop();
+  /**
+   * The Clock time the next step edge is due at while the axis is moving, 0
+   * while a step is half sent and the falling edge is due on the next tick
+   */
+  uint64_t getNextEdgeMicros();
+};
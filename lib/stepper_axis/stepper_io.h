@@ -3,10 +3,10 @@
 #pragma once
 
 /**
- * This defines the HW interface for the leadscrew, abstracted away from the
+ * This defines the HW interface for a stepper driver, abstracted away from the
  * actual calls so we can test it more easily
  */
-class LeadscrewIO {
+class StepperIO {
  public:
   virtual void writeStepPin(uint8_t val) = 0;
   virtual uint8_t readStepPin() = 0;
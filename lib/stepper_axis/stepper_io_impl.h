@@ -0,0 +1,15 @@
+#include <Wire.h>
+
+#include "stepper_io.h"
+#pragma once
+
+// the pins are template arguments so digitalWriteFast still compiles down to a
+// single store
+template <int stepPin, int dirPin>
+class StepperIOImpl : public StepperIO {
+  inline void writeStepPin(uint8_t val) { digitalWriteFast(stepPin, val); }
+  inline uint8_t readStepPin() { return digitalReadFast(stepPin); }
+
+  inline void writeDirPin(uint8_t val) { digitalWriteFast(dirPin, val); }
+  inline u_int8_t readDirPin() { return digitalReadFast(dirPin); }
+};
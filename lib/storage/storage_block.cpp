@@ -0,0 +1,100 @@
+#include "storage_block.h"
+
+#include <cstring>
+
+static uint16_t fletcher16(const uint8_t* data, int length) {
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (int i = 0; i < length; i++) {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+StorageBlock::StorageBlock(StorageIO* io, int address, uint8_t magic,
+                           uint8_t version)
+    : m_io(io), m_address(address), m_magic(magic), m_version(version) {}
+
+int StorageBlock::load(uint8_t* payload, int maxLength) {
+  uint8_t block[MAX_PAYLOAD + OVERHEAD];
+  m_io->read(m_address, block, 3);
+  if (block[0] != m_magic || block[1] != m_version || block[2] > maxLength) {
+    return -1;
+  }
+
+  int length = block[2];
+  m_io->read(m_address + 3, block + 3, length + 2);
+  uint16_t checksum = block[3 + length] | (block[4 + length] << 8);
+  if (checksum != fletcher16(block, length + 3)) {
+    return -1;
+  }
+
+  memcpy(payload, block + 3, length);
+  return length;
+}
+
+void StorageBlock::save(const uint8_t* payload, int length) {
+  uint8_t block[MAX_PAYLOAD + OVERHEAD];
+  block[0] = m_magic;
+  block[1] = m_version;
+  block[2] = length;
+  memcpy(block + 3, payload, length);
+  uint16_t checksum = fletcher16(block, length + 3);
+  block[3 + length] = checksum & 0xFF;
+  block[4 + length] = checksum >> 8;
+  m_io->write(m_address, block, length + OVERHEAD);
+}
+
+void BinaryWriter::writeU8(uint8_t value) { m_buffer[m_length++] = value; }
+
+void BinaryWriter::writeU16(uint16_t value) {
+  writeU8(value & 0xFF);
+  writeU8(value >> 8);
+}
+
+void BinaryWriter::writeU32(uint32_t value) {
+  writeU16(value & 0xFFFF);
+  writeU16(value >> 16);
+}
+
+void BinaryWriter::writeI64(int64_t value) {
+  writeU32((uint64_t)value & 0xFFFFFFFF);
+  writeU32((uint64_t)value >> 32);
+}
+
+void BinaryWriter::writeFloat(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  writeU32(bits);
+}
+
+uint8_t BinaryReader::readU8() {
+  if (m_position >= m_length) {
+    m_position++;
+    return 0;
+  }
+  return m_buffer[m_position++];
+}
+
+uint16_t BinaryReader::readU16() {
+  uint16_t low = readU8();
+  return low | (readU8() << 8);
+}
+
+uint32_t BinaryReader::readU32() {
+  uint32_t low = readU16();
+  return low | ((uint32_t)readU16() << 16);
+}
+
+int64_t BinaryReader::readI64() {
+  uint64_t low = readU32();
+  return low | ((uint64_t)readU32() << 32);
+}
+
+float BinaryReader::readFloat() {
+  uint32_t bits = readU32();
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
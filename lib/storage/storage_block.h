@@ -0,0 +1,71 @@
+#include <cstdint>
+
+#include "storage_io.h"
+#pragma once
+
+/**
+ * A versioned block of persistent data
+ *
+ * Layout: magic byte, version byte, payload length byte, the payload, then a
+ * 16 bit Fletcher checksum over everything before it. A block that doesn't
+ * match all of these is treated as missing, so a half written block or one
+ * from an older firmware never gets loaded
+ */
+class StorageBlock {
+ private:
+  StorageIO* m_io;
+  const int m_address;
+  const uint8_t m_magic;
+  const uint8_t m_version;
+
+ public:
+  // the header and checksum around the payload
+  static const int OVERHEAD = 5;
+  static const int MAX_PAYLOAD = 255;
+
+  StorageBlock(StorageIO* io, int address, uint8_t magic, uint8_t version);
+
+  /**
+   * Read the payload into payload, returns its length or -1 if there is no
+   * valid block of this version
+   */
+  int load(uint8_t* payload, int maxLength);
+  void save(const uint8_t* payload, int length);
+};
+
+/**
+ * Fixed little endian encoding so the layout doesn't depend on the compiler's
+ * struct packing
+ */
+class BinaryWriter {
+ private:
+  uint8_t* m_buffer;
+  int m_length;
+
+ public:
+  BinaryWriter(uint8_t* buffer) : m_buffer(buffer), m_length(0) {}
+  void writeU8(uint8_t value);
+  void writeU16(uint16_t value);
+  void writeU32(uint32_t value);
+  void writeI64(int64_t value);
+  void writeFloat(float value);
+  int getLength() { return m_length; }
+};
+
+class BinaryReader {
+ private:
+  const uint8_t* m_buffer;
+  const int m_length;
+  int m_position;
+
+ public:
+  BinaryReader(const uint8_t* buffer, int length)
+      : m_buffer(buffer), m_length(length), m_position(0) {}
+  uint8_t readU8();
+  uint16_t readU16();
+  uint32_t readU32();
+  int64_t readI64();
+  float readFloat();
+  // false if anything was read past the end
+  bool isValid() { return m_position <= m_length; }
+};
@@ -0,0 +1,17 @@
+#include <cstdint>
+
+#pragma once
+
+/**
+ * This defines the HW interface for the persistent storage (the emulated
+ * EEPROM on the Teensy), abstracted away so we can test it more easily
+ */
+class StorageIO {
+ public:
+  virtual void read(int address, uint8_t* data, int length) = 0;
+  /**
+   * Only bytes that differ are actually written, the EEPROM is emulated in
+   * flash which wears out
+   */
+  virtual void write(int address, const uint8_t* data, int length) = 0;
+};
@@ -0,0 +1,19 @@
+#include <EEPROM.h>
+
+#include "storage_io.h"
+#pragma once
+
+class StorageIOImpl : public StorageIO {
+ public:
+  void read(int address, uint8_t* data, int length) override {
+    for (int i = 0; i < length; i++) {
+      data[i] = EEPROM.read(address + i);
+    }
+  }
+
+  void write(int address, const uint8_t* data, int length) override {
+    for (int i = 0; i < length; i++) {
+      EEPROM.update(address + i, data[i]);
+    }
+  }
+};
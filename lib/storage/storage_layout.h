@@ -0,0 +1,11 @@
+#pragma once
+
+/**
+ * Where each StorageBlock lives in the persistent storage, sizes include the
+ * block header and checksum
+ */
+#define STORAGE_MACHINE_PROFILE_ADDRESS 0
+#define STORAGE_MACHINE_PROFILE_SIZE 64
+#define STORAGE_SESSION_ADDRESS \
+  (STORAGE_MACHINE_PROFILE_ADDRESS + STORAGE_MACHINE_PROFILE_SIZE)
+#define STORAGE_SESSION_SIZE 64
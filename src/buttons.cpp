@@ -3,23 +3,32 @@
 #include <config.h>
 #include <globalstate.h>
 
-ButtonHandler::ButtonHandler(Spindle* spindle, Leadscrew* leadscrew)
+// in the same order as ButtonId
+static const uint8_t buttonPins[BUTTON_COUNT] = {
+    ELS_RATE_INCREASE_BUTTON, ELS_RATE_DECREASE_BUTTON, ELS_MODE_CYCLE_BUTTON,
+    ELS_THREAD_SYNC_BUTTON,   ELS_HALF_NUT_BUTTON,      ELS_ENABLE_BUTTON,
+    ELS_LOCK_BUTTON,          ELS_JOG_LEFT_BUTTON,      ELS_JOG_RIGHT_BUTTON};
+
+ButtonHandler::ButtonHandler(Spindle* spindle, Leadscrew* leadscrew,
+                             Handwheel* handwheel)
     : m_spindle(spindle),
       m_leadscrew(leadscrew),
-      m_rateIncrease(ELS_RATE_INCREASE_BUTTON),
-      m_rateDecrease(ELS_RATE_DECREASE_BUTTON),
-      m_modeCycle(ELS_MODE_CYCLE_BUTTON),
-      m_threadSync(ELS_THREAD_SYNC_BUTTON),
-      m_halfNut(ELS_HALF_NUT_BUTTON),
-      m_enable(ELS_ENABLE_BUTTON),
-      m_lock(ELS_LOCK_BUTTON),
-      m_jogLeft(ELS_JOG_LEFT_BUTTON),
-      m_jogRight(ELS_JOG_RIGHT_BUTTON) {
-  Button setHeldTime(50);
-  Button setClickTime(200);
+      m_handwheel(handwheel),
+      m_globalState(GlobalState::getInstance()),
+      m_io(buttonPins, BUTTON_COUNT),
+      m_scanner(&m_io, ELS_BUTTON_SAMPLE_MS, ELS_BUTTON_HELD_MS,
+                ELS_BUTTON_CLICK_MS),
+      m_events(),
+      m_handwheelMultiplier(0) {
+  if (m_handwheel != nullptr) {
+    m_handwheel->setRatio(mpgMultipliers[m_handwheelMultiplier]);
+  }
 }
 
 void ButtonHandler::handle() {
+  // sample all the buttons at once, the handlers only look at the events
+  m_events = m_scanner.scan();
+
   // update the state of the application based on the button state
   rateIncreaseHandler();
   rateDecreaseHandler();
@@ -28,88 +37,71 @@ void ButtonHandler::handle() {
   halfNutHandler();
   enableHandler();
   lockHandler();
+  handwheelHandler();
   jogHandler();
+
+  // hand the resulting mode to the leadscrew timer in one go
+  m_leadscrew->setMotionMode(m_globalState->getMotionMode());
+  // threads are picked up in phase pass after pass, feeds start wherever
+  m_leadscrew->setThreadSync(m_globalState->getFeedMode() ==
+                             GlobalFeedMode::THREAD);
 }
 
 void ButtonHandler::rateIncreaseHandler() {
-  m_rateIncrease.handle();
-
-  GlobalButtonLock lockState = GlobalState::getInstance()->getButtonLock();
-  if (lockState == GlobalButtonLock::LOCKED) {
-    m_rateIncrease.resetClicked();
-    m_rateIncrease.resetSingleClicked();
-    m_rateIncrease.resetDoubleClicked();
-
+  if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
     return;
   }
 
-  if (m_rateIncrease.resetSingleClicked()) {
-    GlobalState::getInstance()->nextFeedPitch();
-    m_leadscrew->setRatio(GlobalState::getInstance()->getCurrentFeedPitch());
+  if (m_events.singleClicked & BUTTON_MASK(BUTTON_RATE_INCREASE)) {
+    m_globalState->nextFeedPitch();
+    m_leadscrew->setRatio(m_globalState->getCurrentFeedPitch());
   }
 }
 
-void ButtonHandler::printState() {
-  Serial.print("Enable: ");
-  if (m_enable.isHeld()) {
+void printButtonState(const ButtonEvents& events, ButtonId button) {
+  uint16_t mask = BUTTON_MASK(button);
+  if (events.held & mask) {
     Serial.println("held");
-  } else if (m_enable.isPressed()) {
+  } else if (events.pressed & mask) {
     Serial.println("pressed");
-  } else if (m_enable.isDoubleClicked()) {
-    Serial.println("double clicked");
   } else {
     Serial.println("released");
   }
+}
+
+void ButtonHandler::printState() {
+  Serial.print("Enable: ");
+  printButtonState(m_events, BUTTON_ENABLE);
   Serial.print("Left jog: ");
-  if (m_jogLeft.isHeld()) {
-    Serial.println("held");
-  } else if (m_jogLeft.isPressed()) {
-    Serial.println("pressed");
-  } else if (m_jogLeft.isDoubleClicked()) {
-    Serial.println("double clicked");
-  } else {
-    Serial.println("released");
-  }
+  printButtonState(m_events, BUTTON_JOG_LEFT);
   Serial.print("Right jog: ");
-  if (m_jogRight.isHeld()) {
-    Serial.println("held");
-  } else if (m_jogRight.isPressed()) {
-    Serial.println("pressed");
-  } else if (m_jogRight.isDoubleClicked()) {
-    Serial.println("double clicked");
-  } else {
-    Serial.println("released");
-  }
+  printButtonState(m_events, BUTTON_JOG_RIGHT);
 }
 
 void ButtonHandler::rateDecreaseHandler() {
-  m_rateDecrease.handle();
-
-  GlobalButtonLock lockState = GlobalState::getInstance()->getButtonLock();
-  if (lockState == GlobalButtonLock::LOCKED) {
-    m_rateDecrease.resetClicked();
-    m_rateDecrease.resetSingleClicked();
-    m_rateDecrease.resetDoubleClicked();
+  if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
     return;
   }
 
-  if (m_rateDecrease.resetSingleClicked()) {
-    GlobalState::getInstance()->prevFeedPitch();
-    m_leadscrew->setRatio(GlobalState::getInstance()->getCurrentFeedPitch());
+  if (m_events.singleClicked & BUTTON_MASK(BUTTON_RATE_DECREASE)) {
+    m_globalState->prevFeedPitch();
+    m_leadscrew->setRatio(m_globalState->getCurrentFeedPitch());
   }
 }
 
 void ButtonHandler::halfNutHandler() {
-  m_halfNut.handle();
-
-  GlobalButtonLock lockState = GlobalState::getInstance()->getButtonLock();
-  if (lockState == GlobalButtonLock::LOCKED) {
-    m_halfNut.resetClicked();
-    m_halfNut.resetSingleClicked();
-    m_halfNut.resetDoubleClicked();
+  if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
     return;
   }
 
+  // cycle through the handwheel multipliers
+  if (m_handwheel != nullptr &&
+      (m_events.clicked & BUTTON_MASK(BUTTON_HALF_NUT))) {
+    m_handwheelMultiplier =
+        (m_handwheelMultiplier + 1) % ARRAY_SIZE(mpgMultipliers);
+    m_handwheel->setRatio(mpgMultipliers[m_handwheelMultiplier]);
+  }
+
   // honestly I don't know what this button should do after the refactor...
 
   /*if (event == Button::SINGLE_CLICKED_EVENT &&
@@ -122,129 +114,145 @@ void ButtonHandler::halfNutHandler() {
 }
 
 void ButtonHandler::enableHandler() {
-  m_enable.handle();
-
-  GlobalButtonLock lockState = GlobalState::getInstance()->getButtonLock();
-  GlobalMotionMode motionMode = GlobalState::getInstance()->getMotionMode();
-  if (lockState == GlobalButtonLock::LOCKED) {
-    m_enable.resetClicked();
-    m_enable.resetSingleClicked();
-    m_enable.resetDoubleClicked();
+  GlobalMotionMode motionMode = m_globalState->getMotionMode();
+  if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
     return;
   }
 
-  if (m_enable.resetClicked()) {
+  if (m_events.clicked & BUTTON_MASK(BUTTON_ENABLE)) {
     Serial.println("Enable button clicked");
-    if (motionMode == GlobalMotionMode::ENABLED) {
-      GlobalState::getInstance()->setMotionMode(GlobalMotionMode::DISABLED);
+    switch (motionMode) {
+      case GlobalMotionMode::ENABLED:
+        m_globalState->setMotionMode(GlobalMotionMode::DISABLED);
+        break;
+      case GlobalMotionMode::DISABLED:
+        m_globalState->setMotionMode(GlobalMotionMode::ENABLED);
+        // a new pass starts, track its following error from scratch
+        m_leadscrew->resetMaxPositionError();
+        break;
+      case GlobalMotionMode::HOLD:
+        // carry on with the pass, the leadscrew merges back into the cut
+        m_globalState->setMotionMode(GlobalMotionMode::ENABLED);
+        break;
+      case GlobalMotionMode::JOG:
+        break;
     }
-    if (motionMode == GlobalMotionMode::DISABLED) {
-      GlobalState::getInstance()->setMotionMode(GlobalMotionMode::ENABLED);
+  }
+
+  // holding it pauses the pass mid cut, holding it again ends the pass
+  if (m_events.heldStarted & BUTTON_MASK(BUTTON_ENABLE)) {
+    if (motionMode == GlobalMotionMode::ENABLED) {
+      m_globalState->setMotionMode(GlobalMotionMode::HOLD);
+    } else if (motionMode == GlobalMotionMode::HOLD) {
+      m_globalState->setMotionMode(GlobalMotionMode::DISABLED);
     }
   }
 }
 
 void ButtonHandler::lockHandler() {
-  m_lock.handle();
-
-  GlobalState* globalState = GlobalState::getInstance();
+  // a single click only, so the clicks of a double click leave the lock alone
+  if (m_events.singleClicked & BUTTON_MASK(BUTTON_LOCK)) {
+    if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
+      m_globalState->setButtonLock(GlobalButtonLock::UNLOCKED);
+    } else {
+      m_globalState->setButtonLock(GlobalButtonLock::LOCKED);
+    }
+  }
 
-  if (m_lock.resetClicked()) {
-    if (globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
-      globalState->setButtonLock(GlobalButtonLock::UNLOCKED);
+  // double clicking the lock swaps between the status and diagnostics pages
+  if (m_events.doubleClicked & BUTTON_MASK(BUTTON_LOCK)) {
+    if (m_globalState->getDisplayPage() == GlobalDisplayPage::STATUS) {
+      m_globalState->setDisplayPage(GlobalDisplayPage::DIAGNOSTICS);
     } else {
-      globalState->setButtonLock(GlobalButtonLock::LOCKED);
+      m_globalState->setDisplayPage(GlobalDisplayPage::STATUS);
     }
   }
 }
 
 void ButtonHandler::threadSyncHandler() {
-  m_threadSync.handle();
-
-  GlobalButtonLock lockState = GlobalState::getInstance()->getButtonLock();
-  if (lockState == GlobalButtonLock::LOCKED) {
-    m_threadSync.resetClicked();
-    m_threadSync.resetSingleClicked();
-    m_threadSync.resetDoubleClicked();
+  if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
     return;
   }
 
-  if (m_threadSync.resetClicked()) {
-    if (GlobalState::getInstance()->getMotionMode() ==
-        GlobalMotionMode::ENABLED) {
-      GlobalState::getInstance()->setThreadSyncState(
-          GlobalThreadSyncState::UNSYNC);
+  GlobalMotionMode motionMode = m_globalState->getMotionMode();
+  bool engaged = motionMode == GlobalMotionMode::ENABLED ||
+                 motionMode == GlobalMotionMode::HOLD;
+
+  if (m_events.clicked & BUTTON_MASK(BUTTON_THREAD_SYNC)) {
+    if (engaged) {
+      m_globalState->setThreadSyncState(GlobalThreadSyncState::UNSYNC);
     } else {
-      GlobalState::getInstance()->setThreadSyncState(
-          GlobalThreadSyncState::SYNC);
+      m_globalState->setThreadSyncState(GlobalThreadSyncState::SYNC);
+
+      // between passes of a multi-start thread, move on to the next start
+      int starts = m_leadscrew->getThreadStarts();
+      if (starts > 1) {
+        int next = (m_leadscrew->getThreadStart() + 1) % starts;
+        m_leadscrew->setThreadStart(next, starts);
+      }
     }
   }
+
+  // holding it forgets the thread, the next pass starts a new one
+  if (m_events.heldStarted & BUTTON_MASK(BUTTON_THREAD_SYNC) && !engaged) {
+    m_leadscrew->resetThreadPhase();
+  }
 }
 
 void ButtonHandler::modeCycleHandler() {
-  m_modeCycle.handle();
-
-  GlobalState* globalState = GlobalState::getInstance();
-  GlobalButtonLock lockState = globalState->getButtonLock();
-
-  if (lockState == GlobalButtonLock::LOCKED) {
-    m_modeCycle.resetClicked();
-    m_modeCycle.resetSingleClicked();
-    m_modeCycle.resetDoubleClicked();
+  if (m_globalState->getButtonLock() == GlobalButtonLock::LOCKED) {
     return;
   }
 
   // pressing mode button swaps between feed and thread
-  if (m_modeCycle.resetClicked()) {
-    switch (GlobalState::getInstance()->getFeedMode()) {
+  if (m_events.clicked & BUTTON_MASK(BUTTON_MODE_CYCLE)) {
+    switch (m_globalState->getFeedMode()) {
       case GlobalFeedMode::FEED:
-        GlobalState::getInstance()->setFeedMode(GlobalFeedMode::THREAD);
+        m_globalState->setFeedMode(GlobalFeedMode::THREAD);
         break;
       case GlobalFeedMode::THREAD:
-        GlobalState::getInstance()->setFeedMode(GlobalFeedMode::FEED);
+        m_globalState->setFeedMode(GlobalFeedMode::FEED);
         break;
     }
-    m_leadscrew->setRatio(globalState->getCurrentFeedPitch());
+    m_leadscrew->setRatio(m_globalState->getCurrentFeedPitch());
   }
 
   // holding mode button swaps between metric and imperial
-  if (m_modeCycle.isHeld()) {
-    switch (GlobalState::getInstance()->getUnitMode()) {
+  if (m_events.heldStarted & BUTTON_MASK(BUTTON_MODE_CYCLE)) {
+    switch (m_globalState->getUnitMode()) {
       case GlobalUnitMode::METRIC:
-        GlobalState::getInstance()->setUnitMode(GlobalUnitMode::IMPERIAL);
+        m_globalState->setUnitMode(GlobalUnitMode::IMPERIAL);
         break;
       case GlobalUnitMode::IMPERIAL:
-        GlobalState::getInstance()->setUnitMode(GlobalUnitMode::METRIC);
+        m_globalState->setUnitMode(GlobalUnitMode::METRIC);
         break;
     }
-    m_leadscrew->setRatio(globalState->getCurrentFeedPitch());
+    m_leadscrew->setRatio(m_globalState->getCurrentFeedPitch());
   }
 }
 
 void ButtonHandler::jogDirectionHandler(JogDirection direction) {
-  GlobalState* globalState = GlobalState::getInstance();
-  GlobalButtonLock lockState = globalState->getButtonLock();
-  GlobalMotionMode motionMode = globalState->getMotionMode();
+  GlobalButtonLock lockState = m_globalState->getButtonLock();
+  GlobalMotionMode motionMode = m_globalState->getMotionMode();
 
-  Button* jogButton =
-      direction == JogDirection::LEFT ? &m_jogLeft : &m_jogRight;
+  uint16_t jogButton = direction == JogDirection::LEFT
+                           ? BUTTON_MASK(BUTTON_JOG_LEFT)
+                           : BUTTON_MASK(BUTTON_JOG_RIGHT);
 
-  // no jogging functionality allowed during lock or enable
+  // no jogging functionality allowed during lock, enable or hold
   if (lockState == GlobalButtonLock::LOCKED ||
-      motionMode == GlobalMotionMode::ENABLED) {
-    jogButton->resetClicked();
-    jogButton->resetSingleClicked();
-    jogButton->resetDoubleClicked();
+      motionMode == GlobalMotionMode::ENABLED ||
+      motionMode == GlobalMotionMode::HOLD) {
     return;
   }
 
-  if (jogButton->isDoubleClicked()) {
+  if (m_events.doubleClicked & jogButton) {
     switch (direction) {
       case JogDirection::LEFT:
         if (m_leadscrew->getStopPositionState(Leadscrew::StopPosition::LEFT) ==
             LeadscrewStopState::UNSET) {
           m_leadscrew->setStopPosition(Leadscrew::StopPosition::LEFT,
-                                       m_leadscrew->getCurrentPosition());
+                                       m_leadscrew->getCurrentPositionNm());
         } else {
           m_leadscrew->unsetStopPosition(Leadscrew::StopPosition::LEFT);
         }
@@ -253,39 +261,70 @@ void ButtonHandler::jogDirectionHandler(JogDirection direction) {
         if (m_leadscrew->getStopPositionState(Leadscrew::StopPosition::RIGHT) ==
             LeadscrewStopState::UNSET) {
           m_leadscrew->setStopPosition(Leadscrew::StopPosition::RIGHT,
-                                       m_leadscrew->getCurrentPosition());
+                                       m_leadscrew->getCurrentPositionNm());
         } else {
           m_leadscrew->unsetStopPosition(Leadscrew::StopPosition::RIGHT);
         }
         break;
     }
-    jogButton->resetDoubleClicked();
   }
 
-  static elapsedMicros jogTimer;
+  // the jog itself is run by the leadscrew timer, we only command it
+  if (m_events.singleClicked & jogButton) {
+    m_globalState->setMotionMode(GlobalMotionMode::JOG);
+    m_globalState->setThreadSyncState(GlobalThreadSyncState::UNSYNC);
+    m_leadscrew->jogDistance(direction * JOG_FINE_STEP_MM);
+  }
 
-  if (jogButton->isHeld() &&
-      jogTimer > JOG_PULSE_DELAY * m_leadscrew->getRatio()) {
-    globalState->setMotionMode(GlobalMotionMode::JOG);
-    globalState->setThreadSyncState(GlobalThreadSyncState::UNSYNC);
+  if (m_events.heldStarted & jogButton) {
+    m_jogHeldTime = 0;
+  }
+
+  // the longer the button is held the faster we go
+  if (m_events.held & jogButton) {
+    m_globalState->setMotionMode(GlobalMotionMode::JOG);
+    m_globalState->setThreadSyncState(GlobalThreadSyncState::UNSYNC);
 
-    jogTimer -= JOG_PULSE_DELAY * m_leadscrew->getRatio();
-    m_leadscrew->incrementCurrentPosition(direction);
+    unsigned int tier = min((unsigned int)(m_jogHeldTime / JOG_TIER_MS),
+                            (unsigned int)ARRAY_SIZE(jogSpeedTiers) - 1);
+    m_leadscrew->setJogSpeed(direction * jogSpeedTiers[tier]);
   }
 }
 
 void ButtonHandler::jogHandler() {
-  GlobalMotionMode motionMode = GlobalState::getInstance()->getMotionMode();
-  m_jogLeft.handle();
-  m_jogRight.handle();
+  GlobalMotionMode motionMode = m_globalState->getMotionMode();
 
   jogDirectionHandler(JogDirection::LEFT);
   jogDirectionHandler(JogDirection::RIGHT);
 
   // common jog functionality
-  // if neither jog button is held, reset the motion mode
-  if (!m_jogLeft.isHeld() && !m_jogRight.isHeld() &&
-      motionMode == GlobalMotionMode::JOG) {
-    GlobalState::getInstance()->setMotionMode(GlobalMotionMode::DISABLED);
+  // if neither jog button is held, ramp the jog down and reset the motion mode
+  // once every jog has finished
+  uint16_t jogButtons =
+      BUTTON_MASK(BUTTON_JOG_LEFT) | BUTTON_MASK(BUTTON_JOG_RIGHT);
+  if (!(m_events.held & jogButtons) && motionMode == GlobalMotionMode::JOG) {
+    m_leadscrew->setJogSpeed(0);
+    if (!m_leadscrew->isJogging()) {
+      m_globalState->setMotionMode(GlobalMotionMode::DISABLED);
+    }
+  }
+}
+
+void ButtonHandler::handwheelHandler() {
+  if (m_handwheel == nullptr) {
+    return;
+  }
+
+  // same rules as the jog buttons, the leadscrew drops any steps while the
+  // handwheel isn't enabled
+  GlobalMotionMode motionMode = m_globalState->getMotionMode();
+  bool enabled = m_globalState->getButtonLock() == GlobalButtonLock::UNLOCKED &&
+                 motionMode != GlobalMotionMode::ENABLED &&
+                 motionMode != GlobalMotionMode::HOLD;
+  m_leadscrew->setHandwheelEnabled(enabled);
+
+  if (enabled && m_handwheel->hasUnconsumedSteps()) {
+    m_globalState->setMotionMode(GlobalMotionMode::JOG);
+    m_globalState->setThreadSyncState(GlobalThreadSyncState::UNSYNC);
   }
 }
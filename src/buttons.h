@@ -1,24 +1,42 @@
-#include <AbleButtons.h>
+#include <button_io_impl.h>
+#include <button_scanner.h>
+#include <globalstate.h>
+#include <handwheel.h>
 #include <leadscrew.h>
 #include <spindle.h>
 
-using Button = AblePullupDoubleClickerButton;
-using ButtonList = AblePullupDoubleClickerButtonList;
+// the bit of each button in the scanner events
+enum ButtonId {
+  BUTTON_RATE_INCREASE,
+  BUTTON_RATE_DECREASE,
+  BUTTON_MODE_CYCLE,
+  BUTTON_THREAD_SYNC,
+  BUTTON_HALF_NUT,
+  BUTTON_ENABLE,
+  BUTTON_LOCK,
+  BUTTON_JOG_LEFT,
+  BUTTON_JOG_RIGHT,
+  BUTTON_COUNT
+};
+
+#define BUTTON_MASK(id) (1 << (id))
 
 class ButtonHandler {
  private:
   Spindle *m_spindle;
   Leadscrew *m_leadscrew;
+  Handwheel *m_handwheel;
+  GlobalState *m_globalState;
+
+  ButtonIOImpl m_io;
+  ButtonScanner m_scanner;
+  ButtonEvents m_events;
+
+  // how long the current jog has been held, picks the jog speed tier
+  elapsedMillis m_jogHeldTime;
 
-  Button m_rateIncrease;
-  Button m_rateDecrease;
-  Button m_modeCycle;
-  Button m_threadSync;
-  Button m_halfNut;
-  Button m_enable;
-  Button m_lock;
-  Button m_jogLeft;
-  Button m_jogRight;
+  // index into mpgMultipliers
+  unsigned int m_handwheelMultiplier;
 
   void rateIncreaseHandler();
   void rateDecreaseHandler();
@@ -32,9 +50,11 @@ class ButtonHandler {
 
   void jogDirectionHandler(JogDirection direction);
   void jogHandler();
+  void handwheelHandler();
 
  public:
-  ButtonHandler(Spindle *spindle, Leadscrew *leadscrew);
+  // handwheel may be null if there isn't one attached
+  ButtonHandler(Spindle *spindle, Leadscrew *leadscrew, Handwheel *handwheel);
 
   void handle();
   void printState();
@@ -2,14 +2,25 @@
 
 #include <SPI.h>
 #include <Wire.h>
+#include <clock.h>
 #include <globalstate.h>
+#include <handwheel.h>
+#include <isr_stats.h>
+#include <cross_slide.h>
+#include <feedback_io_impl.h>
 #include <leadscrew.h>
-#include <leadscrew_io_impl.h>
+#include <machine_profile.h>
+#include <session.h>
 #include <spindle.h>
+#include <step_scheduler.h>
+#include <stepper_io_impl.h>
+#include <storage_io_impl.h>
 
 #include "buttons.h"
 #include "config.h"
+#include "config_checks.h"
 #include "display.h"
+#include "serial_console.h"
 
 IntervalTimer timer;
 
@@ -19,19 +30,73 @@ Spindle spindle;
 #else
 Spindle spindle(ELS_SPINDLE_ENCODER_A, ELS_SPINDLE_ENCODER_B);
 #endif
-LeadscrewIOImpl leadscrewIOImpl;
+StepperIOImpl<ELS_LEADSCREW_STEP, ELS_LEADSCREW_DIR> leadscrewIOImpl;
 Leadscrew leadscrew(&spindle, &leadscrewIOImpl,
                     LEADSCREW_INITIAL_PULSE_DELAY_US,
                     LEADSCREW_PULSE_DELAY_STEP_US, ELS_LEADSCREW_STEPPER_PPR,
                     ELS_LEADSCREW_PITCH_MM);
-ButtonHandler keyPad(&spindle, &leadscrew);
-Display display(&spindle, &leadscrew);
+#ifdef ELS_LEADSCREW_FEEDBACK_A
+FeedbackIOImpl<ELS_LEADSCREW_FEEDBACK_A, ELS_LEADSCREW_FEEDBACK_B>
+    leadscrewFeedbackImpl;
+#endif
+#ifdef ELS_CROSS_SLIDE_STEP
+StepperIOImpl<ELS_CROSS_SLIDE_STEP, ELS_CROSS_SLIDE_DIR> crossSlideIOImpl;
+CrossSlide crossSlide(&crossSlideIOImpl, &leadscrew,
+                      CROSS_SLIDE_INITIAL_PULSE_DELAY_US,
+                      CROSS_SLIDE_PULSE_DELAY_STEP_US,
+                      ELS_CROSS_SLIDE_STEPPER_PPR, ELS_CROSS_SLIDE_PITCH_MM);
+CrossSlide* crossSlidePtr = &crossSlide;
+#else
+CrossSlide* crossSlidePtr = nullptr;
+#endif
+StepScheduler stepScheduler;
+#ifdef ELS_MPG_ENCODER_A
+Handwheel handwheel(ELS_MPG_ENCODER_A, ELS_MPG_ENCODER_B,
+                    ELS_MPG_COUNTS_PER_DETENT);
+ButtonHandler keyPad(&spindle, &leadscrew, &handwheel);
+#else
+ButtonHandler keyPad(&spindle, &leadscrew, nullptr);
+#endif
+IsrStats isrStats;
+Display display(&spindle, &leadscrew, &isrStats);
+StorageIOImpl storageIOImpl;
+MachineProfileStore machineProfileStore(&storageIOImpl);
+MachineProfile machineProfile = MachineProfile::defaults();
+SessionStore sessionStore(&storageIOImpl);
+SerialConsole serialConsole(&spindle, &leadscrew, crossSlidePtr,
+                            &machineProfileStore, &machineProfile);
+
+// how often the timer callback statistics are sampled
+#define ISR_STATS_WINDOW_MS 250
+
+// the period the timer currently runs at in us
+volatile uint32_t timerPeriod = LEADSCREW_TIMER_US;
 
 // have to handle the leadscrew updates in a timer callback so we can update the
 // screen independently without losing pulses
 void timerCallback() {
+  uint32_t start = ARM_DWT_CYCCNT;
+  Clock::tick();
   spindle.update();
-  leadscrew.update();
+#ifdef ELS_MPG_ENCODER_A
+  handwheel.update();
+#endif
+  stepScheduler.update();
+
+  // run the timer to the next deadline of any axis, at most
+  // ELS_IDLE_TIMER_US so the spindle and handwheel are still polled. begin()
+  // restarts the period from now so the next tick is on time
+  uint64_t deadline = stepScheduler.getNextDeadline();
+  uint64_t now = Clock::micros();
+  uint64_t untilDeadline = deadline > now ? deadline - now : 0;
+  untilDeadline = min(untilDeadline, (uint64_t)ELS_IDLE_TIMER_US);
+  uint32_t period =
+      (uint32_t)max(untilDeadline, (uint64_t)LEADSCREW_TIMER_US);
+  if (period != timerPeriod) {
+    timerPeriod = period;
+    timer.begin(timerCallback, period);
+  }
+  isrStats.record(ARM_DWT_CYCCNT - start);
 }
 
 void setup() {
@@ -50,9 +115,21 @@ void setup() {
 #ifndef ELS_SPINDLE_DRIVEN
   pinMode(ELS_SPINDLE_ENCODER_A, INPUT_PULLUP);  // encoder pin 1
   pinMode(ELS_SPINDLE_ENCODER_B, INPUT_PULLUP);  // encoder pin 2
+#endif
+#ifdef ELS_MPG_ENCODER_A
+  pinMode(ELS_MPG_ENCODER_A, INPUT_PULLUP);
+  pinMode(ELS_MPG_ENCODER_B, INPUT_PULLUP);
+#endif
+#ifdef ELS_LEADSCREW_FEEDBACK_A
+  pinMode(ELS_LEADSCREW_FEEDBACK_A, INPUT_PULLUP);
+  pinMode(ELS_LEADSCREW_FEEDBACK_B, INPUT_PULLUP);
 #endif
   pinMode(ELS_LEADSCREW_STEP, OUTPUT);              // step output pin
   pinMode(ELS_LEADSCREW_DIR, OUTPUT);               // direction output pin
+#ifdef ELS_CROSS_SLIDE_STEP
+  pinMode(ELS_CROSS_SLIDE_STEP, OUTPUT);
+  pinMode(ELS_CROSS_SLIDE_DIR, OUTPUT);
+#endif
   pinMode(ELS_RATE_INCREASE_BUTTON, INPUT_PULLUP);  // rate Inc
   pinMode(ELS_RATE_DECREASE_BUTTON, INPUT_PULLUP);  // rate Dec
   pinMode(ELS_MODE_CYCLE_BUTTON, INPUT_PULLUP);     // mode cycle
@@ -63,26 +140,67 @@ void setup() {
   pinMode(ELS_JOG_LEFT_BUTTON, INPUT_PULLUP);       // jog left
   pinMode(ELS_JOG_RIGHT_BUTTON, INPUT_PULLUP);      // jog right
 
-  // Display Initalisation
-
-  display.init();
+  // the machine profile has to be in place before the timer starts
+  bool profileLoaded = machineProfileStore.load(machineProfile);
+  serialConsole.applyProfile();
 
+  // pick up where the last session left off
   leadscrew.setRatio(globalState->getCurrentFeedPitch());
+  SessionState session;
+  bool sessionLoaded = sessionStore.load(session);
+  if (sessionLoaded) {
+    session.apply(globalState, &leadscrew);
+  }
+#ifdef ELS_MPG_ENCODER_A
+  leadscrew.setHandwheel(&handwheel);
+#endif
+#ifdef ELS_LEADSCREW_FEEDBACK_A
+  leadscrew.setFeedback(&leadscrewFeedbackImpl,
+                        ELS_LEADSCREW_FEEDBACK_COUNTS_PER_MM);
+#endif
 
-  display.update();
+  stepScheduler.addAxis(&leadscrew);
+#ifdef ELS_CROSS_SLIDE_STEP
+  // after the leadscrew so a taper follows its steps from the same tick
+  stepScheduler.addAxis(&crossSlide);
+#endif
 
+  // the motion is live from here, the display and serial console come up from
+  // the loop so they can't hold it up
   timer.begin(timerCallback, LEADSCREW_TIMER_US);
 
-  delay(2000);
-
+  if (!profileLoaded) {
+    Serial.println("No machine profile stored, using the defaults");
+  }
+  if (!sessionLoaded) {
+    Serial.println("No session stored, using the defaults");
+  }
   Serial.print("Initial pulse delay: ");
-  Serial.println(LEADSCREW_INITIAL_PULSE_DELAY_US);
+  Serial.println(leadscrew.getMotionConstants().initialPulseDelay);
   Serial.print("Pulse delay step: ");
-  Serial.println(LEADSCREW_PULSE_DELAY_STEP_US);
+  Serial.println(leadscrew.getMotionConstants().pulseDelayIncrement);
 }
 
 void loop() {
+  // the timer has stopped the leadscrew already, disabling it lets it take
+  // the position from the feedback again
+  if (leadscrew.hasFeedbackFault() &&
+      globalState->getMotionMode() != GlobalMotionMode::DISABLED) {
+    globalState->setMotionMode(GlobalMotionMode::DISABLED);
+    Serial.println("Leadscrew following error too large, disabled");
+  }
   keyPad.handle();
+  serialConsole.handle();
+#ifdef ELS_CROSS_SLIDE_STEP
+  crossSlide.setMotionMode(globalState->getMotionMode());
+#endif
+  sessionStore.handle(SessionState::capture(globalState, &leadscrew));
+
+  static elapsedMillis lastIsrSample;
+  if (lastIsrSample > ISR_STATS_WINDOW_MS) {
+    lastIsrSample = 0;
+    isrStats.sample();
+  }
 
   static elapsedMicros lastPrint;
   if (lastPrint > 1000 * 500) {
@@ -91,6 +209,9 @@ void loop() {
     Serial.print("Micros: ");
     Serial.println(micros());
     leadscrew.printState();
+#ifdef ELS_CROSS_SLIDE_STEP
+    crossSlide.printState();
+#endif
     Serial.print("Spindle position: ");
     Serial.println(spindle.getCurrentPosition());
     Serial.print("Spindle velocity: ");
@@ -98,6 +219,12 @@ void loop() {
     Serial.print("Spindle velocity pulses: ");
     Serial.println(spindle.getEstimatedVelocityInPulsesPerSecond());
     keyPad.printState();
+    Serial.print("Motion timer period us: ");
+    Serial.println(timerPeriod);
+    Serial.print("Display load %: ");
+    Serial.println(display.getRenderLoadPercent());
+    Serial.print("Display max update us: ");
+    Serial.println(display.getMaxUpdateMicros());
   }
 
   display.update();
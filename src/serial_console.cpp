@@ -0,0 +1,222 @@
+#include "serial_console.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+SerialConsole::SerialConsole(Spindle *spindle, Leadscrew *leadscrew,
+                             CrossSlide *crossSlide,
+                             MachineProfileStore *profileStore,
+                             MachineProfile *profile)
+    : m_spindle(spindle),
+      m_leadscrew(leadscrew),
+      m_crossSlide(crossSlide),
+      m_profileStore(profileStore),
+      m_profile(profile),
+      m_globalState(GlobalState::getInstance()),
+      m_lineLength(0) {}
+
+void SerialConsole::applyProfile() {
+  const char *error = m_profile->validate();
+  if (error != nullptr) {
+    Serial.print("Machine profile invalid, using defaults: ");
+    Serial.println(error);
+    *m_profile = MachineProfile::defaults();
+  }
+
+  m_spindle->setPulsesPerRevolution(m_profile->spindlePulsePerRevolution);
+  m_leadscrew->setMotionConstants(m_profile->getMotionConstants());
+  if (m_crossSlide != nullptr) {
+    m_crossSlide->setMotionConstants(m_profile->getCrossSlideMotionConstants());
+  }
+}
+
+void SerialConsole::handle() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\r') {
+      continue;
+    }
+    if (c != '\n') {
+      // anything past the end of the buffer is dropped, the command will
+      // just fail to parse
+      if (m_lineLength < SERIAL_CONSOLE_LINE_LENGTH - 1) {
+        m_line[m_lineLength++] = c;
+      }
+      continue;
+    }
+
+    m_line[m_lineLength] = '\0';
+    m_lineLength = 0;
+    runCommand(m_line);
+  }
+}
+
+void SerialConsole::runCommand(char *line) {
+  char *arguments = nullptr;
+  char *command = strtok_r(line, " ", &arguments);
+  if (command == nullptr) {
+    return;
+  }
+
+  if (strcmp(command, "profile") == 0) {
+    profileCommand(arguments);
+    return;
+  }
+  if (strcmp(command, "cross") == 0) {
+    crossSlideCommand(arguments);
+    return;
+  }
+  if (strcmp(command, "thread") == 0) {
+    threadCommand(arguments);
+    return;
+  }
+  if (strcmp(command, "taper") == 0) {
+    taperCommand(arguments);
+    return;
+  }
+
+  Serial.print("Unknown command: ");
+  Serial.println(command);
+}
+
+void SerialConsole::profileCommand(char *arguments) {
+  char *name = strtok_r(nullptr, " ", &arguments);
+  if (name == nullptr) {
+    printProfile();
+    return;
+  }
+
+  if (m_globalState->getMotionMode() != GlobalMotionMode::DISABLED) {
+    Serial.println("Disable the leadscrew before changing the profile");
+    return;
+  }
+
+  MachineProfile previous = *m_profile;
+
+  if (strcmp(name, "defaults") == 0) {
+    *m_profile = MachineProfile::defaults();
+    updateProfile(previous);
+    return;
+  }
+
+  char *value = strtok_r(nullptr, " ", &arguments);
+  char *end = nullptr;
+  float number = value == nullptr ? 0 : strtof(value, &end);
+  if (value == nullptr || *end != '\0' || !m_profile->setField(name, number)) {
+    Serial.println("Usage: profile <name> <value>");
+    return;
+  }
+
+  updateProfile(previous);
+}
+
+void SerialConsole::crossSlideCommand(char *arguments) {
+  if (m_crossSlide == nullptr) {
+    Serial.println("No cross slide configured");
+    return;
+  }
+
+  char *value = strtok_r(nullptr, " ", &arguments);
+  if (value == nullptr) {
+    Serial.print("Cross slide position mm: ");
+    Serial.println((float)m_crossSlide->getCurrentPositionNm() / NM_PER_MM);
+    return;
+  }
+
+  if (m_globalState->getMotionMode() != GlobalMotionMode::DISABLED) {
+    Serial.println("Disable the leadscrew before moving the cross slide");
+    return;
+  }
+
+  char *end = nullptr;
+  float mm = strtof(value, &end);
+  if (*end != '\0') {
+    Serial.println("Usage: cross <mm>");
+    return;
+  }
+  m_crossSlide->moveTo(llround(mm * NM_PER_MM));
+}
+
+void SerialConsole::threadCommand(char *arguments) {
+  char *start = strtok_r(nullptr, " ", &arguments);
+  if (start == nullptr) {
+    Serial.print("Thread start: ");
+    Serial.print(m_leadscrew->getThreadStart());
+    Serial.print(" of ");
+    Serial.println(m_leadscrew->getThreadStarts());
+    return;
+  }
+
+  GlobalMotionMode mode = m_globalState->getMotionMode();
+  if (mode == GlobalMotionMode::ENABLED || mode == GlobalMotionMode::HOLD) {
+    Serial.println("Disable the leadscrew before changing the thread");
+    return;
+  }
+
+  if (strcmp(start, "new") == 0) {
+    m_leadscrew->resetThreadPhase();
+    return;
+  }
+
+  char *starts = strtok_r(nullptr, " ", &arguments);
+  char *startEnd = nullptr;
+  char *startsEnd = nullptr;
+  long startNumber = strtol(start, &startEnd, 10);
+  long startsNumber = starts == nullptr ? 0 : strtol(starts, &startsEnd, 10);
+  if (starts == nullptr || *startEnd != '\0' || *startsEnd != '\0' ||
+      startsNumber < 1 || startNumber < 0 || startNumber >= startsNumber) {
+    Serial.println("Usage: thread <start> <starts>, start counts from 0");
+    return;
+  }
+  m_leadscrew->setThreadStart(startNumber, startsNumber);
+}
+
+void SerialConsole::taperCommand(char *arguments) {
+  if (m_crossSlide == nullptr) {
+    Serial.println("No cross slide configured");
+    return;
+  }
+
+  char *value = strtok_r(nullptr, " ", &arguments);
+  if (value == nullptr) {
+    Serial.print("Taper ratio: ");
+    Serial.println(m_crossSlide->getRatio());
+    return;
+  }
+
+  if (m_globalState->getMotionMode() != GlobalMotionMode::DISABLED) {
+    Serial.println("Disable the leadscrew before changing the taper");
+    return;
+  }
+
+  char *end = nullptr;
+  float ratio = strtof(value, &end);
+  if (*end != '\0' || !(fabsf(ratio) <= 1)) {
+    Serial.println("Usage: taper <ratio>, at most 1 either way");
+    return;
+  }
+  m_crossSlide->setRatio(ratio);
+}
+
+void SerialConsole::updateProfile(const MachineProfile &previous) {
+  const char *error = m_profile->validate();
+  if (error != nullptr) {
+    *m_profile = previous;
+    Serial.print("Profile not changed: ");
+    Serial.println(error);
+    return;
+  }
+
+  applyProfile();
+  m_profileStore->save(*m_profile);
+  printProfile();
+}
+
+void SerialConsole::printProfile() {
+  for (int field = 0; field < MachineProfile::FIELD_COUNT; field++) {
+    Serial.print(MachineProfile::getFieldName(field));
+    Serial.print(": ");
+    Serial.println(m_profile->getField(field));
+  }
+}
@@ -0,0 +1,63 @@
+#include <cross_slide.h>
+#include <globalstate.h>
+#include <leadscrew.h>
+#include <machine_profile.h>
+#include <spindle.h>
+
+#pragma once
+
+#define SERIAL_CONSOLE_LINE_LENGTH 64
+
+/**
+ * Line based commands over the USB serial port
+ *
+ *   profile                 print the machine profile
+ *   profile <name> <value>  change a field, applied and saved if it is valid
+ *   profile defaults        go back to the config.h values
+ *   cross                   print the cross slide position
+ *   cross <mm>              move the cross slide to a position
+ *   thread                  print the thread start being cut
+ *   thread <start> <starts> cut start <start> (from 0) of a multi-start thread
+ *   thread new              forget the thread, the next pass starts a new one
+ *   taper <ratio>           follow the carriage with the cross slide while
+ *                           the leadscrew is enabled, cross slide mm per
+ *                           carriage mm, 0 turns it off
+ *
+ * The profile, cross slide position and taper can only be changed while the
+ * leadscrew is disabled
+ */
+class SerialConsole {
+ private:
+  Spindle *m_spindle;
+  Leadscrew *m_leadscrew;
+  CrossSlide *m_crossSlide;
+  MachineProfileStore *m_profileStore;
+  MachineProfile *m_profile;
+  GlobalState *m_globalState;
+
+  char m_line[SERIAL_CONSOLE_LINE_LENGTH];
+  int m_lineLength;
+
+  void runCommand(char *line);
+  void profileCommand(char *arguments);
+  void crossSlideCommand(char *arguments);
+  void taperCommand(char *arguments);
+  void threadCommand(char *arguments);
+  void printProfile();
+  // validate the edited profile and apply and save it, or put back the old one
+  void updateProfile(const MachineProfile &previous);
+
+ public:
+  // crossSlide is nullptr if there isn't a motorised one
+  SerialConsole(Spindle *spindle, Leadscrew *leadscrew, CrossSlide *crossSlide,
+                MachineProfileStore *profileStore, MachineProfile *profile);
+
+  /**
+   * Hand the current profile to the spindle and leadscrew, falls back to the
+   * defaults if it isn't valid
+   */
+  void applyProfile();
+
+  // read whatever has arrived on the serial port, never blocks
+  void handle();
+};
@@ -0,0 +1,96 @@
+#ifndef PIO_UNIT_TESTING
+#define PIO_UNIT_TESTING  // for intellisense to pick up the MillisSingleton etc
+                          // classes
+#endif
+
+#include <button_scanner.h>
+#include <els_elapsedMillis.h>
+#include <gmock/gmock.h>
+
+#include "mocks/buttonio_mock.h"
+
+#define SAMPLE_MS 5
+#define HELD_MS 1000
+#define CLICK_MS 500
+
+// scan repeatedly until the given time has passed, collecting every event
+ButtonEvents scanFor(ButtonScanner& scanner, unsigned long duration) {
+  MillisSingleton& millis = MillisSingleton::getInstance();
+  ButtonEvents collected = {};
+  for (unsigned long elapsed = 0; elapsed < duration; elapsed++) {
+    millis.incrementMillis();
+    ButtonEvents events = scanner.scan();
+    collected.pressed = events.pressed;
+    collected.held = events.held;
+    collected.heldStarted |= events.heldStarted;
+    collected.clicked |= events.clicked;
+    collected.singleClicked |= events.singleClicked;
+    collected.doubleClicked |= events.doubleClicked;
+  }
+  return collected;
+}
+
+TEST(ButtonScannerTest, TestDebounce) {
+  ButtonIOMock io;
+  ButtonScanner scanner(&io, SAMPLE_MS, HELD_MS, CLICK_MS);
+
+  // a bounce shorter than 4 samples is ignored
+  io.setPressed(0b1);
+  ButtonEvents events = scanFor(scanner, SAMPLE_MS * 2);
+  ASSERT_EQ(events.pressed, 0);
+  io.setPressed(0);
+  scanFor(scanner, SAMPLE_MS * 2);
+
+  io.setPressed(0b1);
+  events = scanFor(scanner, SAMPLE_MS * 5);
+  ASSERT_EQ(events.pressed, 0b1);
+}
+
+TEST(ButtonScannerTest, TestSingleAndDoubleClick) {
+  ButtonIOMock io;
+  ButtonScanner scanner(&io, SAMPLE_MS, HELD_MS, CLICK_MS);
+
+  io.setPressed(0b10);
+  scanFor(scanner, 50);
+  io.setPressed(0);
+  ButtonEvents events = scanFor(scanner, 50);
+  ASSERT_EQ(events.clicked, 0b10);
+  ASSERT_EQ(events.singleClicked, 0);
+
+  // nothing else happens, it turns into a single click
+  events = scanFor(scanner, CLICK_MS);
+  ASSERT_EQ(events.singleClicked, 0b10);
+  ASSERT_EQ(events.doubleClicked, 0);
+
+  // two quick clicks
+  io.setPressed(0b10);
+  scanFor(scanner, 50);
+  io.setPressed(0);
+  scanFor(scanner, 50);
+  io.setPressed(0b10);
+  scanFor(scanner, 50);
+  io.setPressed(0);
+  events = scanFor(scanner, CLICK_MS * 2);
+  ASSERT_EQ(events.doubleClicked, 0b10);
+  ASSERT_EQ(events.singleClicked, 0);
+}
+
+TEST(ButtonScannerTest, TestHeld) {
+  ButtonIOMock io;
+  ButtonScanner scanner(&io, SAMPLE_MS, HELD_MS, CLICK_MS);
+
+  io.setPressed(0b100);
+  ButtonEvents events = scanFor(scanner, HELD_MS / 2);
+  ASSERT_EQ(events.held, 0);
+
+  events = scanFor(scanner, HELD_MS);
+  ASSERT_EQ(events.held, 0b100);
+  ASSERT_EQ(events.heldStarted, 0b100);
+
+  // releasing a hold isn't a click
+  io.setPressed(0);
+  events = scanFor(scanner, CLICK_MS * 2);
+  ASSERT_EQ(events.held, 0);
+  ASSERT_EQ(events.clicked, 0);
+  ASSERT_EQ(events.singleClicked, 0);
+}
@@ -0,0 +1,90 @@
+#ifndef PIO_UNIT_TESTING
+#define PIO_UNIT_TESTING  // for intellisense to pick up the MicrosSingleton etc
+                          // classes
+#endif
+
+#include <clock.h>
+#include <config.h>
+#include <els_elapsedMillis.h>
+#include <globalstate.h>
+#include <gmock/gmock.h>
+#include <leadscrew.h>
+#include <spindle.h>
+
+#include <cstdint>
+
+#include "mocks/stepperio_mock.h"
+
+// the first microsecond after micros() wraps
+#define MICROS_WRAP ((uint64_t)UINT32_MAX + 1)
+
+class ClockTest : public ::testing::Test {
+ protected:
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+
+  // the other tests expect time to start at 0
+  void TearDown() override { micros.setMicros(0); }
+};
+
+TEST_F(ClockTest, TestMonotonicAcrossWrap) {
+  micros.setMicros(MICROS_WRAP - 10);
+  uint64_t before = Clock::micros();
+  elapsedMicros64 elapsed;
+
+  micros.incrementMicros(20);
+
+  // micros() has wrapped, the clock hasn't
+  ASSERT_EQ(micros.micros(), 10u);
+  ASSERT_EQ(Clock::micros(), before + 20);
+  ASSERT_EQ((uint64_t)elapsed, 20u);
+}
+
+TEST_F(ClockTest, TestLeadscrewStepsAcrossWrap) {
+  GlobalState* globalState = GlobalState::getInstance();
+  // wrap between the first and second step of the same move as
+  // PositionTest.TestInitialPulseDelay
+  uint64_t start = MICROS_WRAP - 200;
+  micros.setMicros(start);
+
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+
+  globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setRatio(1);
+  spindle.setCurrentPosition(100);
+
+  while (micros.micros64() < start + 100 + 20) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  }
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 1);
+
+  uint64_t secondStep = start + 100 + 20 + 90 + 20;
+  while (micros.micros64() + LEADSCREW_TIMER_US < secondStep) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+    ASSERT_EQ(leadscrew.getCurrentPosition(), 1);
+  }
+  micros.incrementMicros(LEADSCREW_TIMER_US);
+  leadscrew.update();
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 2);
+}
+
+TEST_F(ClockTest, TestSpindleVelocityAcrossWrap) {
+  micros.setMicros(MICROS_WRAP - 1000);
+  Spindle spindle;
+
+  // 10,000 pulses a second through the wrap
+  for (int i = 0; i < 20; i++) {
+    micros.incrementMicros(100);
+    spindle.incrementCurrentPosition(1);
+    ASSERT_EQ(spindle.getEstimatedVelocityInPulsesPerSecond(), 10000u);
+  }
+
+  // sitting still for just over a wrap must not look like a fast pulse
+  micros.incrementMicros(MICROS_WRAP + 50);
+  spindle.incrementCurrentPosition(1);
+  ASSERT_EQ(spindle.getEstimatedVelocityInPulsesPerSecond(), 0u);
+}
@@ -0,0 +1,127 @@
+#include <config.h>
+#include <els_elapsedMillis.h>
+#include <globalstate.h>
+#include <gmock/gmock.h>
+#include <handwheel.h>
+#include <leadscrew.h>
+#include <spindle.h>
+
+#include "mocks/stepperio_mock.h"
+
+TEST(HandwheelTest, TestOnlyWholeDetentsCount) {
+  Handwheel handwheel(0, 0, 4);
+
+  // resting between two detents doesn't move anything
+  handwheel.getEncoder().write(3);
+  handwheel.update();
+  ASSERT_FALSE(handwheel.hasUnconsumedSteps());
+  ASSERT_EQ(handwheel.consumeSteps(), 0);
+
+  // the rest of the detent is kept until the wheel gets there
+  handwheel.getEncoder().write(1);
+  handwheel.update();
+  ASSERT_TRUE(handwheel.hasUnconsumedSteps());
+  ASSERT_EQ(handwheel.consumeSteps(), 1);
+  ASSERT_FALSE(handwheel.hasUnconsumedSteps());
+
+  // and the same going back
+  handwheel.getEncoder().write(-7);
+  handwheel.update();
+  ASSERT_EQ(handwheel.consumeSteps(), -1);
+  handwheel.getEncoder().write(-1);
+  handwheel.update();
+  ASSERT_EQ(handwheel.consumeSteps(), -1);
+}
+
+TEST(HandwheelTest, TestMultiplier) {
+  Handwheel handwheel(0, 0, 4);
+  handwheel.setRatio(10);
+  ASSERT_EQ(handwheel.getRatio(), 10);
+
+  handwheel.getEncoder().write(8);
+  handwheel.update();
+  ASSERT_EQ(handwheel.consumeSteps(), 20);
+}
+
+class HandwheelJogTest : public ::testing::Test {
+ protected:
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Handwheel handwheel{0, 0, 4};
+  // 100 steps per mm
+  Leadscrew leadscrew{&spindle, &stepperIOMock, 2000, 0.02, 100, 1};
+
+  void SetUp() override {
+    leadscrew.setHandwheel(&handwheel);
+    leadscrew.setHandwheelEnabled(true);
+    leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  }
+
+  void TearDown() override { micros.setMicros(0); }
+
+  void turn(int counts) {
+    handwheel.getEncoder().write(counts);
+    handwheel.update();
+  }
+
+  void tick() {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  }
+
+  void run() {
+    for (int i = 0; i < 2000000 / LEADSCREW_TIMER_US; i++) {
+      tick();
+    }
+  }
+};
+
+TEST_F(HandwheelJogTest, TestPartialDetentsNeverMoveTheCarriage) {
+  turn(3);
+  run();
+  ASSERT_EQ(leadscrew.getExpectedPosition(), 0);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 0);
+
+  turn(2);
+  run();
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 1);
+  ASSERT_FALSE(leadscrew.isJogging());
+}
+
+TEST_F(HandwheelJogTest, TestMultiplierMovesTheCarriage) {
+  handwheel.setRatio(10);
+  turn(-8);
+  run();
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -20);
+  ASSERT_FALSE(leadscrew.isJogging());
+}
+
+TEST_F(HandwheelJogTest, TestBacklogIsCapped) {
+  const int maxBacklogSteps = ELS_MPG_MAX_BACKLOG_MM * 100;
+  handwheel.setRatio(100);
+
+  // far more than the backlog in one go, the rest is dropped
+  turn(4 * 5);
+  tick();
+  ASSERT_EQ(leadscrew.getExpectedPosition(), maxBacklogSteps);
+
+  // more while it is still behind only tops the backlog up
+  for (int i = 0; i < 100; i++) {
+    tick();
+  }
+  int moved = leadscrew.getCurrentPosition();
+  ASSERT_GT(moved, 0);
+  turn(4 * 5);
+  tick();
+  ASSERT_LE(leadscrew.getExpectedPosition() - leadscrew.getCurrentPosition(),
+            maxBacklogSteps);
+  ASSERT_GT(leadscrew.getExpectedPosition(), maxBacklogSteps);
+
+  // the other way it can go back to the carriage and a backlog past it
+  run();
+  int position = leadscrew.getCurrentPosition();
+  turn(-4 * 5);
+  tick();
+  ASSERT_EQ(leadscrew.getExpectedPosition(), position - maxBacklogSteps);
+}
@@ -0,0 +1,97 @@
+#include <config.h>
+#include <gmock/gmock.h>
+#include <machine_profile.h>
+#include <storage_layout.h>
+
+#include "mocks/storageio_mock.h"
+
+TEST(MachineProfileTest, TestDefaultsMatchConfig) {
+  MachineProfile profile = MachineProfile::defaults();
+  ASSERT_EQ(profile.validate(), nullptr);
+
+  // the timer has to run exactly like it did with the compile time values
+  MotionConstants constants = profile.getMotionConstants();
+  ASSERT_EQ(constants.spindlePulsePerRevolution, ELS_SPINDLE_COUNTS_PER_REV);
+  ASSERT_EQ(constants.motorPulsePerRevolution, ELS_LEADSCREW_STEPPER_PPR);
+  ASSERT_FLOAT_EQ(constants.initialPulseDelay,
+                  LEADSCREW_INITIAL_PULSE_DELAY_US);
+  ASSERT_FLOAT_EQ(constants.pulseDelayIncrement,
+                  LEADSCREW_PULSE_DELAY_STEP_US);
+  ASSERT_EQ(constants.leadscrewPitchNm, 1250000);
+}
+
+TEST(MachineProfileTest, TestCrossSlideRampsWithTheProfile) {
+  MachineProfile profile = MachineProfile::defaults();
+  MotionConstants constants = profile.getCrossSlideMotionConstants();
+  ASSERT_EQ(constants.motorPulsePerRevolution, ELS_CROSS_SLIDE_STEPPER_PPR);
+  ASSERT_FLOAT_EQ(constants.initialPulseDelay,
+                  CROSS_SLIDE_INITIAL_PULSE_DELAY_US);
+  ASSERT_FLOAT_EQ(constants.pulseDelayIncrement,
+                  CROSS_SLIDE_PULSE_DELAY_STEP_US);
+
+  // its screw stays as it is, its ramp follows the profile
+  ASSERT_TRUE(profile.setField("pitch", 2));
+  ASSERT_TRUE(profile.setField("accel", LEADSCREW_ACCEL / 2));
+  ASSERT_TRUE(profile.setField("jerk", LEADSCREW_JERK / 2));
+  constants = profile.getCrossSlideMotionConstants();
+  ASSERT_EQ(constants.leadscrewPitch, ELS_CROSS_SLIDE_PITCH_MM);
+  ASSERT_FLOAT_EQ(constants.initialPulseDelay,
+                  2 * CROSS_SLIDE_INITIAL_PULSE_DELAY_US);
+  ASSERT_FLOAT_EQ(constants.pulseDelayIncrement,
+                  CROSS_SLIDE_PULSE_DELAY_STEP_US / 2);
+}
+
+TEST(MachineProfileTest, TestSaveAndLoad) {
+  StorageIOMock storage;
+  MachineProfileStore store(&storage);
+  MachineProfile loaded = MachineProfile::defaults();
+
+  // nothing stored yet
+  ASSERT_FALSE(store.load(loaded));
+
+  MachineProfile profile = MachineProfile::defaults();
+  ASSERT_TRUE(profile.setField("pitch", 2));
+  ASSERT_TRUE(profile.setField("stepper_ppr", 800));
+  store.save(profile);
+
+  ASSERT_TRUE(store.load(loaded));
+  ASSERT_EQ(loaded.motorPulsePerRevolution, 800);
+  ASSERT_FLOAT_EQ(loaded.leadscrewPitch, 2);
+  ASSERT_FLOAT_EQ(loaded.jogSpeed, JOG_SPEED);
+}
+
+TEST(MachineProfileTest, TestRejectsCorruptOrOldProfiles) {
+  StorageIOMock storage;
+  MachineProfileStore store(&storage);
+  MachineProfile profile = MachineProfile::defaults();
+  profile.setField("pitch", 2);
+  store.save(profile);
+
+  // a flipped bit fails the checksum
+  storage.m_data[STORAGE_MACHINE_PROFILE_ADDRESS + 5] ^= 0x10;
+  MachineProfile loaded = MachineProfile::defaults();
+  ASSERT_FALSE(store.load(loaded));
+  ASSERT_FLOAT_EQ(loaded.leadscrewPitch, ELS_LEADSCREW_PITCH_MM);
+
+  // a profile from another layout version is ignored
+  store.save(profile);
+  storage.m_data[STORAGE_MACHINE_PROFILE_ADDRESS + 1] =
+      MACHINE_PROFILE_VERSION + 1;
+  ASSERT_FALSE(store.load(loaded));
+}
+
+TEST(MachineProfileTest, TestValidation) {
+  MachineProfile profile = MachineProfile::defaults();
+  ASSERT_FALSE(profile.setField("nonsense", 1));
+
+  // faster than the leadscrew timer can step
+  profile.setField("jog_speed", 1000);
+  ASSERT_NE(profile.validate(), nullptr);
+
+  profile = MachineProfile::defaults();
+  profile.setField("pitch", 0);
+  ASSERT_NE(profile.validate(), nullptr);
+
+  profile = MachineProfile::defaults();
+  ASSERT_FALSE(profile.setField("spindle_ppr", -1));
+}
@@ -0,0 +1,10 @@
+#include <button_io.h>
+#pragma once
+
+class ButtonIOMock : public ButtonIO {
+  uint16_t m_pressed = 0;
+
+ public:
+  void setPressed(uint16_t pressed) { m_pressed = pressed; }
+  uint16_t readButtons() override { return m_pressed; }
+};
@@ -0,0 +1,10 @@
+#include <feedback_io.h>
+
+#pragma once
+
+class FeedbackIOMock : public FeedbackIO {
+ public:
+  int32_t m_counts = 0;
+
+  int32_t readCounts() override { return m_counts; }
+};
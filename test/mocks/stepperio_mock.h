@@ -0,0 +1,21 @@
+
+#pragma once
+
+class StepperIOMock : public StepperIO {
+  uint8_t m_stepPinState = 0;
+  uint8_t m_dirPinState = 0;
+
+ public:
+  // where the motor is in steps, whether or not the axis moved with it
+  int m_motorSteps = 0;
+
+  void writeStepPin(uint8_t state) override {
+    if (state == 1 && m_stepPinState != 1) {
+      m_motorSteps += m_dirPinState == 1 ? 1 : -1;
+    }
+    m_stepPinState = state;
+  }
+  void writeDirPin(uint8_t state) override { m_dirPinState = state; }
+  uint8_t readStepPin() override { return m_stepPinState; }
+  uint8_t readDirPin() override { return m_dirPinState; }
+};
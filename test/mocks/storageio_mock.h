@@ -0,0 +1,21 @@
+#include <storage_io.h>
+
+#include <cstring>
+#pragma once
+
+class StorageIOMock : public StorageIO {
+ public:
+  // erased flash reads as 0xFF
+  uint8_t m_data[1024];
+  int m_bytesWritten = 0;
+
+  StorageIOMock() { memset(m_data, 0xFF, sizeof(m_data)); }
+
+  void read(int address, uint8_t* data, int length) override {
+    memcpy(data, m_data + address, length);
+  }
+  void write(int address, const uint8_t* data, int length) override {
+    memcpy(m_data + address, data, length);
+    m_bytesWritten += length;
+  }
+};
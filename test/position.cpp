@@ -16,7 +16,8 @@
 using std::vector;
 
 #include "mocks/axis_mock.h"
-#include "mocks/leadscrewio_mock.h"
+#include "mocks/feedbackio_mock.h"
+#include "mocks/stepperio_mock.h"
 
 struct position {
   unsigned long micros;
@@ -32,13 +33,14 @@ TEST(PositionTest, TestInitialPulseDelay) {
   MicrosSingleton& micros = MicrosSingleton::getInstance();
   GlobalState* globalState = GlobalState::getInstance();
 
-  LeadscrewIOMock leadscrewIOMock;
+  StepperIOMock stepperIOMock;
   Spindle spindle;
-  Leadscrew leadscrew(&spindle, &leadscrewIOMock, 100, 0.1, 100, 1);
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
   // test data
   // define the time and the expected position of the leadscrew
 
   globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
   spindle.setCurrentPosition(100);
 
   vector<position> expectedStepPositions = {
@@ -85,62 +87,751 @@ TEST(PositionTest, TestInitialPulseDelay) {
   }
 }
 
-TEST(PositionTest, TestAccumulator) {
+TEST(PositionTest, TestStepsPerSpindlePulse) {
   MicrosSingleton& micros = MicrosSingleton::getInstance();
   GlobalState* globalState = GlobalState::getInstance();
-  LeadscrewIOMock leadscrewIOMock;
+  StepperIOMock stepperIOMock;
   Spindle spindle;
-  // no accel - only positioning
-  Leadscrew leadscrew(&spindle, &leadscrewIOMock, 0, 0, 100, 1);
-  // test data
-  // define the time and the expected position of the leadscrew
+  // no accel - only positioning, 100 steps per mm
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 0, 0, 100, 1);
 
   globalState->setMotionMode(GlobalMotionMode::ENABLED);
-  leadscrew.setRatio(6);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  // 6 leadscrew steps per spindle pulse
+  leadscrew.setRatio(6.0 * ELS_SPINDLE_ENCODER_PPR / 100);
 
   spindle.setCurrentPosition(1);
 
-  // 6
-  micros.incrementMicros(LEADSCREW_TIMER_US);
-  leadscrew.update();
-  micros.incrementMicros(LEADSCREW_TIMER_US);
-  leadscrew.update();
-  ASSERT_EQ(leadscrew.getCurrentPosition(), 0);
+  // one step every other update, never past where the spindle says
+  int previousPosition = 0;
+  for (int i = 0; i < 20; i++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+    ASSERT_GE(leadscrew.getCurrentPosition(), previousPosition);
+    ASSERT_LE(leadscrew.getCurrentPosition(), previousPosition + 1);
+    ASSERT_LE(leadscrew.getCurrentPosition(), 6);
+    previousPosition = leadscrew.getCurrentPosition();
+  }
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 6);
+  ASSERT_EQ(leadscrew.getCurrentPositionNm(), 60000);
+}
 
-  // acc: 5
-  micros.incrementMicros(LEADSCREW_TIMER_US);
-  leadscrew.update();
+TEST(PositionTest, TestSpindleCountsAddUpUntilConsumed) {
+  Spindle spindle;
+  spindle.setCurrentPosition(ELS_SPINDLE_COUNTS_PER_REV - 1);
+  spindle.consumePosition();
+
+  // two updates before the leadscrew gets to them, one across the wrap
+  spindle.incrementCurrentPosition(1);
+  spindle.incrementCurrentPosition(2);
+  ASSERT_EQ(spindle.getCurrentPosition(), 2);
+  ASSERT_EQ(spindle.consumePosition(), 3);
+  ASSERT_EQ(spindle.consumePosition(), 0);
+}
+
+TEST(PositionTest, TestRatioChangeKeepsPosition) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 0, 0, 100, 1);
+
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setRatio(1);
+  spindle.setCurrentPosition(10);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
-  // 4
-  ASSERT_EQ(leadscrew.getCurrentPosition(), 0);
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(),
+            10 * NM_PER_MM / ELS_SPINDLE_ENCODER_PPR);
 
+  // with the spindle stopped, changing the ratio must not move where the
+  // leadscrew should be, only how fast it gets there from now on
+  const int stillTicks = 2 * ELS_SPINDLE_DECEL_WINDOW_US / LEADSCREW_TIMER_US;
+  for (int tick = 0; tick < stillTicks; tick++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  }
+  leadscrew.setRatio(2);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(),
+            10 * NM_PER_MM / ELS_SPINDLE_ENCODER_PPR);
+
+  spindle.setCurrentPosition(11);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
-  // 3
-  ASSERT_EQ(leadscrew.getCurrentPosition(), 0);
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(),
+            12 * NM_PER_MM / ELS_SPINDLE_ENCODER_PPR);
+}
+
+TEST(PositionTest, TestRatioChangeWaitsForRevolution) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 0, 0, 100, 1);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setRatio(1);
+
+  // a count every 2ms, a slow threading speed
+  auto turn = [&](int counts) {
+    for (int count = 0; count < counts; count++) {
+      spindle.incrementCurrentPosition(1);
+      for (int tick = 0; tick < 2000 / LEADSCREW_TIMER_US; tick++) {
+        micros.incrementMicros(LEADSCREW_TIMER_US);
+        leadscrew.update();
+      }
+    }
+  };
+  int64_t countNm = NM_PER_MM / ELS_SPINDLE_COUNTS_PER_REV;
+
+  // part way round the new ratio is held back until the next revolution
+  turn(ELS_SPINDLE_COUNTS_PER_REV / 4);
+  leadscrew.setRatio(2);
+  for (int count = ELS_SPINDLE_COUNTS_PER_REV / 4;
+       count < ELS_SPINDLE_COUNTS_PER_REV; count++) {
+    ASSERT_EQ(leadscrew.getExpectedPositionNm(), count * countNm);
+    turn(1);
+  }
+
+  // and carries on from the boundary at the new ratio
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(), NM_PER_MM);
+  turn(10);
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(), NM_PER_MM + 20 * countNm);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestNoDriftOverLongTravel) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 0, 0, 100, 1);
+
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setRatio(1.5);
+
+  // far past where a float position stops resolving single spindle pulses
+  const int revolutions = 50000;
+  for (int i = 0; i < revolutions * ELS_SPINDLE_ENCODER_PPR; i++) {
+    spindle.incrementCurrentPosition(1);
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  }
+
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(),
+            (int64_t)revolutions * 1500000);
+}
+
+// run the timer until the leadscrew has caught up
+void settle(Leadscrew& leadscrew) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  for (int i = 0; i < 20000; i++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  }
+}
+
+TEST(PositionTest, TestThreadPhaseKeptBetweenPasses) {
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // 100 steps per mm
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+  leadscrew.setRatio(1);
+  leadscrew.setThreadSync(true);
+
+  // first pass, half a revolution
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  spindle.setCurrentPosition(ELS_SPINDLE_ENCODER_PPR / 2);
+  settle(leadscrew);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 50);
+
+  // back off past the start
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  leadscrew.jogDistance(-2.3);
+  settle(leadscrew);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -180);
+
+  // the thread passes through 0.5mm + whole turns at this spindle angle, the
+  // nearest to the carriage is -1.5mm
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  settle(leadscrew);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -150);
+
+  // the second of four starts is a quarter of a turn further on
+  leadscrew.setMotionMode(GlobalMotionMode::DISABLED);
+  settle(leadscrew);
+  leadscrew.setThreadStart(1, 4);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  settle(leadscrew);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -175);
+
+  // and it still follows the spindle from there
+  spindle.setCurrentPosition(ELS_SPINDLE_ENCODER_PPR / 2 +
+                             ELS_SPINDLE_ENCODER_PPR / 4);
+  settle(leadscrew);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -150);
+
+  // a new thread starts wherever the carriage is
+  leadscrew.setMotionMode(GlobalMotionMode::DISABLED);
+  settle(leadscrew);
+  leadscrew.resetThreadPhase();
+  leadscrew.setThreadStart(0, 1);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  settle(leadscrew);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -150);
+
+  MicrosSingleton::getInstance().setMicros(0);
+}
+
+// turn the spindle a pulse every 400us, 6.25 revolutions per second
+void turnSpindle(Spindle& spindle, Leadscrew& leadscrew, int pulses,
+                 int pulseMicros = 400) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  for (int i = 0; i < pulses; i++) {
+    for (int tick = 0; tick < pulseMicros / LEADSCREW_TIMER_US; tick++) {
+      micros.incrementMicros(LEADSCREW_TIMER_US);
+      leadscrew.update();
+    }
+    spindle.incrementCurrentPosition(1);
+  }
+}
+
+TEST(PositionTest, TestFeedHoldResumesOnTheSameThread) {
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // 100 steps per mm
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+  leadscrew.setRatio(1);
+  leadscrew.setThreadSync(true);
+
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  turnSpindle(spindle, leadscrew, ELS_SPINDLE_ENCODER_PPR);
+  ASSERT_LE(abs(leadscrew.getPositionError()), 1);
+
+  // the carriage stops while the spindle keeps turning
+  leadscrew.setMotionMode(GlobalMotionMode::HOLD);
+  turnSpindle(spindle, leadscrew, ELS_SPINDLE_ENCODER_PPR / 2);
+  int heldAt = leadscrew.getCurrentPosition();
+  ASSERT_LT(heldAt, 150);
+  turnSpindle(spindle, leadscrew, ELS_SPINDLE_ENCODER_PPR);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), heldAt);
+
+  // and merges back into the thread it was cutting, a whole number of turns
+  // behind where it would have been without the hold
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  turnSpindle(spindle, leadscrew, 2 * ELS_SPINDLE_ENCODER_PPR);
+  int withoutHold = 450;
+  ASSERT_LE(abs(leadscrew.getPositionError()), 1);
+  ASSERT_EQ(leadscrew.getExpectedPosition() % 100, withoutHold % 100);
+  ASSERT_LT(leadscrew.getExpectedPosition(), withoutHold);
+  ASSERT_GT(leadscrew.getCurrentPosition(), heldAt);
+
+  MicrosSingleton::getInstance().setMicros(0);
+}
+
+TEST(PositionTest, TestFeedHoldResumesAtThreadingSpeed) {
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // a count every 2ms, slower than the spindle's own estimate can see
+  const int pulseMicros = 2000;
+  // 100 steps per mm
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+  leadscrew.setRatio(1);
+  leadscrew.setThreadSync(true);
+
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  turnSpindle(spindle, leadscrew, ELS_SPINDLE_ENCODER_PPR,
+              pulseMicros);
+  ASSERT_LE(abs(leadscrew.getPositionError()), 1);
+
+  // the carriage stops while the spindle keeps turning
+  leadscrew.setMotionMode(GlobalMotionMode::HOLD);
+  turnSpindle(spindle, leadscrew, ELS_SPINDLE_ENCODER_PPR / 2,
+              pulseMicros);
+  int heldAt = leadscrew.getCurrentPosition();
+  ASSERT_LT(heldAt, 150);
+  turnSpindle(spindle, leadscrew, ELS_SPINDLE_ENCODER_PPR,
+              pulseMicros);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), heldAt);
+
+  // and ramps up into the thread it was cutting rather than jumping onto the
+  // nearest turn of it, a whole number of turns behind where it would have
+  // been without the hold
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  int maxError = 0;
+  for (int pulse = 0; pulse < 2 * ELS_SPINDLE_ENCODER_PPR; pulse++) {
+    turnSpindle(spindle, leadscrew, 1, pulseMicros);
+    maxError = std::max(maxError, abs(leadscrew.getPositionError()));
+  }
+  ASSERT_LE(maxError, 1);
+  int withoutHold = 450;
+  ASSERT_LE(abs(leadscrew.getPositionError()), 1);
+  ASSERT_EQ(leadscrew.getExpectedPosition() % 100, withoutHold % 100);
+  ASSERT_LT(leadscrew.getExpectedPosition(), withoutHold);
+  ASSERT_GT(leadscrew.getCurrentPosition(), heldAt);
+
+  MicrosSingleton::getInstance().setMicros(0);
+}
+
+// the time between the last two steps, so how fast the carriage is going
+class StepTimer {
+ private:
+  int m_lastPosition = 0;
+  uint64_t m_lastStepMicros = 0;
+
+ public:
+  int direction = 0;
+  uint64_t interval = 0;
+
+  // true on a step
+  bool update(int position) {
+    if (position == m_lastPosition) {
+      return false;
+    }
+    uint64_t now = MicrosSingleton::getInstance().micros64();
+    direction = position > m_lastPosition ? 1 : -1;
+    interval = now - m_lastStepMicros;
+    m_lastPosition = position;
+    m_lastStepMicros = now;
+    return true;
+  }
+};
+
+TEST(PositionTest, TestRampsDownIntoStops) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // 100 steps per mm, starting at 250 steps/s
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setStopPosition(Leadscrew::StopPosition::RIGHT, 5 * NM_PER_MM);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  leadscrew.jogDistance(10);
+
+  StepTimer timer;
+  uint64_t fastest = UINT64_MAX;
+  for (int tick = 0; tick < 2000000 / LEADSCREW_TIMER_US; tick++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+    if (timer.update(leadscrew.getCurrentPosition())) {
+      fastest = std::min(fastest, timer.interval);
+    }
+  }
+
+  // it got up to speed and was slowing down when it got to the stop
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 500);
+  ASSERT_LT(fastest, 1000);
+  ASSERT_GT(timer.interval, 2 * fastest);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestFollowsReversingSpindle) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // 100 steps per mm, starting at 250 steps/s
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setRatio(1);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+
+  // the spindle runs at 10 rev/s for a second, then slows down for 0.1s and
+  // speeds back up the other way, it turns 10.5 revolutions in
+  const float speed = 10.0 * ELS_SPINDLE_ENCODER_PPR;
+  const float accel = speed / 0.1;
+  int count = 0;
+  int furthest = 0;
+  StepTimer timer;
+  uint64_t firstStepBack = 0;
+  for (int tick = 0; tick < 1400000 / LEADSCREW_TIMER_US; tick++) {
+    float t = (float)tick * LEADSCREW_TIMER_US / US_PER_SECOND;
+    float slowing = t > 1 ? t - 1 : 0;
+    int position = floor(speed * t - accel * slowing * slowing / 2);
+    spindle.incrementCurrentPosition(position - count);
+    count = position;
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+
+    int direction = timer.direction;
+    furthest = std::max(furthest, leadscrew.getCurrentPosition());
+    if (timer.update(leadscrew.getCurrentPosition()) && direction == 1 &&
+        timer.direction == -1) {
+      firstStepBack = timer.interval;
+    }
+  }
+
+  // it never went past where the spindle turned, turned from standstill and
+  // is back with the spindle
+  ASSERT_LE(furthest, 1050);
+  ASSERT_GE(firstStepBack, 2 * 2000);
+  ASSERT_LE(abs(leadscrew.getPositionError()), 20);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestTakesUpBacklashOnReversal) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // 100 steps per mm, starting at 250 steps/s, with 0.05mm of slack
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  MotionConstants constants = leadscrew.getMotionConstants();
+  constants.backlashSteps = 5;
+  leadscrew.setMotionConstants(constants);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+
+  auto jog = [&](float mm) {
+    leadscrew.jogDistance(mm);
+    for (int tick = 0; tick < 2000000 / LEADSCREW_TIMER_US; tick++) {
+      micros.incrementMicros(LEADSCREW_TIMER_US);
+      leadscrew.update();
+    }
+    ASSERT_FALSE(leadscrew.isJogging());
+  };
+
+  // the slack is taken up already going the first way
+  jog(1);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 100);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, 100);
+
+  // the motor turns the slack further on the way back, the position doesn't
+  jog(-0.5);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 50);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, 45);
+
+  jog(0.5);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 100);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, 100);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestFeedbackRecoversLostSteps) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  FeedbackIOMock feedback;
+  Spindle spindle;
+  // 100 steps per mm, starting at 250 steps/s, with a count per step
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setFeedback(&feedback, 100);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+
+  // the motor skips 3 steps 30 steps in, then stalls altogether 50 steps
+  // into the second jog
+  int lostSteps = 0;
+  auto run = [&]() {
+    for (int tick = 0; tick < 2000000 / LEADSCREW_TIMER_US; tick++) {
+      micros.incrementMicros(LEADSCREW_TIMER_US);
+      leadscrew.update();
+      int motorSteps = stepperIOMock.m_motorSteps;
+      if (motorSteps == 30 && lostSteps == 0) {
+        lostSteps = 3;
+      }
+      feedback.m_counts = std::min(motorSteps, 150) - lostSteps;
+    }
+  };
 
+  leadscrew.jogDistance(1);
+  run();
+  ASSERT_FALSE(leadscrew.isJogging());
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 100);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, 103);
+  ASSERT_EQ(leadscrew.getMaxFollowingError(), 3);
+  ASSERT_FALSE(leadscrew.hasFeedbackFault());
+
+  // stepping stops as soon as more than 0.5mm is lost
+  leadscrew.jogDistance(1);
+  run();
+  ASSERT_TRUE(leadscrew.hasFeedbackFault());
+  ASSERT_EQ(stepperIOMock.m_motorSteps, 150 + 51);
+
+  // disabling clears it and takes the position from the feedback
+  leadscrew.setMotionMode(GlobalMotionMode::DISABLED);
+  run();
+  ASSERT_FALSE(leadscrew.hasFeedbackFault());
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 147);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestDirectionIsSetUpBeforeTheStep) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  // 100 steps per mm, starting at 250 steps/s
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  leadscrew.jogDistance(-2);
+
+  uint8_t lastDir = stepperIOMock.readDirPin();
+  uint8_t lastStep = stepperIOMock.readStepPin();
+  uint64_t dirChanged = 0;
+  uint64_t lastStepEdge = 0;
+  uint64_t reversalGap = 0;
+  int reversals = 0;
+  for (int tick = 0; tick < 3000000 / LEADSCREW_TIMER_US; tick++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    // turn around at speed
+    if (tick == 50000 / LEADSCREW_TIMER_US) {
+      leadscrew.jogDistance(2.5);
+    }
+    leadscrew.update();
+
+    uint64_t now = micros.micros64();
+    uint8_t dir = stepperIOMock.readDirPin();
+    uint8_t step = stepperIOMock.readStepPin();
+    if (dir != lastDir) {
+      // never in the middle of a step
+      ASSERT_EQ(step, 0);
+      dirChanged = now;
+      reversals++;
+    }
+    if (step == 1 && lastStep == 0) {
+      ASSERT_GE(now - dirChanged, ELS_STEPPER_DIR_SETUP_US);
+      if (dirChanged > lastStepEdge && lastStepEdge != 0) {
+        reversalGap = now - lastStepEdge;
+      }
+      lastStepEdge = now;
+    }
+    lastDir = dir;
+    lastStep = step;
+  }
+
+  // the first move left sets the pin up as well, the turn right only waits
+  // for the pulse delay at the jerk speed
+  ASSERT_EQ(reversals, 1);
+  ASSERT_GT(reversalGap, 0);
+  ASSERT_LE(reversalGap, 2000 + 2 * LEADSCREW_TIMER_US);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 50);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestFeedbackFaultStopsStepping) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  FeedbackIOMock feedback;
+  Spindle spindle;
+  // 100 steps per mm, starting at 250 steps/s, with a count per step
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setFeedback(&feedback, 100);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  leadscrew.jogDistance(2);
+
+  auto tick = [&]() {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  };
+
+  // the carriage follows until it jams while a step edge is out, the next
+  // tick sees it far behind
+  int motorSteps = 0;
+  while (true) {
+    tick();
+    if (stepperIOMock.readStepPin() == 1 && stepperIOMock.m_motorSteps > 20) {
+      motorSteps = stepperIOMock.m_motorSteps;
+      break;
+    }
+    feedback.m_counts = stepperIOMock.m_motorSteps;
+  }
+  feedback.m_counts = -100;
+  tick();
+  ASSERT_TRUE(leadscrew.hasFeedbackFault());
+  ASSERT_EQ(stepperIOMock.readStepPin(), 0);
+  // the step that was out is counted
+  ASSERT_EQ(leadscrew.getCurrentPosition(), motorSteps);
+
+  // nothing is sent while faulted
+  for (int i = 0; i < 1000000 / LEADSCREW_TIMER_US; i++) {
+    tick();
+  }
+  ASSERT_EQ(stepperIOMock.m_motorSteps, motorSteps);
+  ASSERT_EQ(stepperIOMock.readStepPin(), 0);
+  ASSERT_TRUE(leadscrew.hasFeedbackFault());
+
+  // disabling follows the feedback, which clears it
+  leadscrew.setMotionMode(GlobalMotionMode::DISABLED);
+  tick();
+  ASSERT_FALSE(leadscrew.hasFeedbackFault());
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -100);
+  ASSERT_EQ(leadscrew.getFollowingError(), 0);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestFineJogsAfterLongTravel) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+
+  // fine steps still add up exactly on top of a metre of jogging
+  leadscrew.jogDistance(1000);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
+  for (int i = 0; i < 3; i++) {
+    leadscrew.jogDistance(0.001);
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    leadscrew.update();
+  }
+  leadscrew.jogDistance(-0.01);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
-  // 2
-  ASSERT_EQ(leadscrew.getCurrentPosition(), 0);
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(), 1000LL * NM_PER_MM - 7000);
 
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestJogSpeedRamps) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  // up to 5mm/s at 10mm/s^2, half a second each way
+  MotionConstants constants = leadscrew.getMotionConstants();
+  constants.maxJogSpeed = 5;
+  constants.jogAccel = 10;
+  leadscrew.setMotionConstants(constants);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+
+  // distance commanded in each 10ms window, which may change by at most
+  // accel * window^2 from one window to the next
+  const int windowTicks = 10000 / LEADSCREW_TIMER_US;
+  const int64_t windowNm = 5 * NM_PER_MM / 100;
+  const int64_t maxChangeNm = 10 * NM_PER_MM / 100 / 100;
+  int64_t lastPosition = 0;
+  int64_t lastDistance = 0;
+  auto run = [&](int windows) {
+    for (int window = 0; window < windows; window++) {
+      for (int tick = 0; tick < windowTicks; tick++) {
+        micros.incrementMicros(LEADSCREW_TIMER_US);
+        leadscrew.update();
+      }
+      int64_t position = leadscrew.getExpectedPositionNm();
+      int64_t distance = position - lastPosition;
+      ASSERT_LE(distance, windowNm + 1);
+      ASSERT_LE(std::abs(distance - lastDistance), maxChangeNm + 1);
+      lastPosition = position;
+      lastDistance = distance;
+    }
+  };
+
+  // asking for more than the maximum ramps up to the maximum
+  leadscrew.setJogSpeed(20);
+  run(60);
+  ASSERT_NEAR(lastDistance, windowNm, 1);
+  run(40);
+  ASSERT_TRUE(leadscrew.isJogging());
+
+  // and back down to a stop, 1.25mm up, 2.5mm at speed and 1.25mm down
+  leadscrew.setJogSpeed(0);
+  run(51);
+  ASSERT_EQ(lastDistance, 0);
+  ASSERT_NEAR(leadscrew.getExpectedPositionNm(), 5 * NM_PER_MM, 2000);
+
+  // the motor catches up to the nearest step and the jog is over
+  run(100);
+  ASSERT_FALSE(leadscrew.isJogging());
+  ASSERT_NEAR(leadscrew.getCurrentPositionNm(),
+              leadscrew.getExpectedPositionNm(), NM_PER_MM / 100 / 2);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, leadscrew.getCurrentPosition());
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestJogTiersAndFineSteps) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 2000, 0.02, 100, 1);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+
+  // windows of 10ms as in TestJogSpeedRamps, at the default jog acceleration
+  // and with a little room for the float ramp rounding at higher speeds
+  const int windowTicks = 10000 / LEADSCREW_TIMER_US;
+  const int64_t maxChangeNm = JOG_ACCEL * NM_PER_MM / 100 / 100 * 101 / 100;
+  int64_t lastPosition = 0;
+  int64_t lastDistance = 0;
+  auto run = [&](int windows, float speed) {
+    for (int window = 0; window < windows; window++) {
+      for (int tick = 0; tick < windowTicks; tick++) {
+        micros.incrementMicros(LEADSCREW_TIMER_US);
+        leadscrew.update();
+      }
+      int64_t position = leadscrew.getExpectedPositionNm();
+      int64_t distance = position - lastPosition;
+      ASSERT_LE(distance, (int64_t)(speed * NM_PER_MM / 100) + 1);
+      ASSERT_LE(std::abs(distance - lastDistance), maxChangeNm + 1);
+      lastPosition = position;
+      lastDistance = distance;
+    }
+  };
+
+  // holding the button steps up a tier every JOG_TIER_MS, as the button
+  // handler does, and each tier is reached before the next one starts
+  for (float speed : jogSpeedTiers) {
+    leadscrew.setJogSpeed(speed);
+    run(JOG_TIER_MS / 10, speed);
+    ASSERT_NEAR(lastDistance, speed * NM_PER_MM / 100, 1);
+  }
+
+  // letting go ramps down from rapid and the motor settles on the position
+  leadscrew.setJogSpeed(0);
+  run(JOG_SPEED * 100 / JOG_ACCEL + 2, JOG_SPEED);
+  ASSERT_EQ(lastDistance, 0);
+  run(100, 0);
+  ASSERT_FALSE(leadscrew.isJogging());
+  ASSERT_NEAR(leadscrew.getCurrentPositionNm(),
+              leadscrew.getExpectedPositionNm(), NM_PER_MM / 100 / 2);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, leadscrew.getCurrentPosition());
+
+  // clicks move by exactly a fine step each, a step of the motor here
+  int64_t expected = leadscrew.getExpectedPositionNm();
+  int position = leadscrew.getCurrentPosition();
+  auto click = [&](int direction) {
+    leadscrew.jogDistance(direction * JOG_FINE_STEP_MM);
+    expected += direction * (int64_t)(JOG_FINE_STEP_MM * NM_PER_MM);
+    position += direction;
+    for (int tick = 0; tick < 100000 / LEADSCREW_TIMER_US; tick++) {
+      micros.incrementMicros(LEADSCREW_TIMER_US);
+      leadscrew.update();
+    }
+    ASSERT_FALSE(leadscrew.isJogging());
+    ASSERT_EQ(leadscrew.getExpectedPositionNm(), expected);
+    ASSERT_EQ(leadscrew.getCurrentPosition(), position);
+  };
+  click(1);
+  click(1);
+  click(1);
+  click(-1);
+  ASSERT_EQ(stepperIOMock.m_motorSteps, position);
+
+  micros.setMicros(0);
+}
+
+TEST(PositionTest, TestConfigPublishedBetweenTicksIsPickedUpWhole) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 0, 0, 100, 1);
+  leadscrew.setRatio(1);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
-  micros.incrementMicros(LEADSCREW_TIMER_US);
-  leadscrew.update();
-  // 1
-  ASSERT_EQ(leadscrew.getCurrentPosition(), 0);
 
+  // the main loop engages at a new ratio, the next tick follows the spindle
+  // with both rather than engaging at the old ratio
+  leadscrew.setRatio(2);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  spindle.setCurrentPosition(10);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(),
+            20 * NM_PER_MM / ELS_SPINDLE_ENCODER_PPR);
+
+  spindle.setCurrentPosition(11);
   micros.incrementMicros(LEADSCREW_TIMER_US);
   leadscrew.update();
-  // 0
-  // position should be 1
-  ASSERT_EQ(leadscrew.getCurrentPosition(), 1);
-}
\ No newline at end of file
+  ASSERT_EQ(leadscrew.getExpectedPositionNm(),
+            22 * NM_PER_MM / ELS_SPINDLE_ENCODER_PPR);
+
+  micros.setMicros(0);
+}
@@ -0,0 +1,65 @@
+#include <gmock/gmock.h>
+#include <seqlock.h>
+
+#include <functional>
+
+// runs once in the middle of the next write, as the timer interrupting the
+// main loop would
+std::function<void()> interruptWrite;
+
+// a value that is half written when the interrupt fires
+struct Snapshot {
+  int first;
+  int second;
+
+  Snapshot() : first(0), second(0) {}
+  Snapshot(int first, int second) : first(first), second(second) {}
+  Snapshot(const Snapshot& other) = default;
+
+  Snapshot& operator=(const Snapshot& other) {
+    first = other.first;
+    if (interruptWrite) {
+      std::function<void()> interrupt = interruptWrite;
+      interruptWrite = nullptr;
+      interrupt();
+    }
+    second = other.second;
+    return *this;
+  }
+};
+
+TEST(SeqLockTest, TestReadsWhatWasWritten) {
+  SeqLock<Snapshot> lock(Snapshot(1, 1));
+  Snapshot out;
+  ASSERT_TRUE(lock.tryRead(out));
+  ASSERT_EQ(out.first, 1);
+  ASSERT_EQ(out.second, 1);
+
+  lock.write(Snapshot(2, 2));
+  ASSERT_TRUE(lock.tryRead(out));
+  ASSERT_EQ(out.first, 2);
+  ASSERT_EQ(out.second, 2);
+}
+
+TEST(SeqLockTest, TestNeverReadsAHalfWrittenValue) {
+  SeqLock<Snapshot> lock(Snapshot(1, 1));
+  Snapshot out(1, 1);
+
+  // a read during the write fails and leaves the last value alone
+  bool interrupted = false;
+  bool readDuringWrite = true;
+  interruptWrite = [&]() {
+    interrupted = true;
+    readDuringWrite = lock.tryRead(out);
+  };
+  lock.write(Snapshot(2, 2));
+  ASSERT_TRUE(interrupted);
+  ASSERT_FALSE(readDuringWrite);
+  ASSERT_EQ(out.first, 1);
+  ASSERT_EQ(out.second, 1);
+
+  // once the write is done the next read gets all of it
+  ASSERT_TRUE(lock.tryRead(out));
+  ASSERT_EQ(out.first, 2);
+  ASSERT_EQ(out.second, 2);
+}
@@ -0,0 +1,98 @@
+#include <config.h>
+#include <els_elapsedMillis.h>
+#include <globalstate.h>
+#include <gmock/gmock.h>
+#include <leadscrew.h>
+#include <session.h>
+#include <spindle.h>
+
+#include "mocks/stepperio_mock.h"
+#include "mocks/storageio_mock.h"
+
+class SessionTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    // the global state is shared with the other tests
+    GlobalState* globalState = GlobalState::getInstance();
+    globalState->setUnitMode(DEFAULT_UNIT_MODE);
+    globalState->setFeedMode(DEFAULT_FEED_MODE);
+    globalState->setMotionMode(GlobalMotionMode::DISABLED);
+    MillisSingleton::getInstance().setMillis(0);
+  }
+};
+
+TEST_F(SessionTest, TestRestoresModePitchAndStops) {
+  GlobalState* globalState = GlobalState::getInstance();
+  StorageIOMock storage;
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+
+  {
+    Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+    globalState->setUnitMode(GlobalUnitMode::IMPERIAL);
+    globalState->setFeedMode(GlobalFeedMode::THREAD);
+    globalState->setFeedSelect(3);
+    leadscrew.setCurrentPosition(1234);
+    leadscrew.setStopPosition(Leadscrew::StopPosition::LEFT, -5000000);
+
+    SessionStore store(&storage);
+    store.save(SessionState::capture(globalState, &leadscrew));
+  }
+
+  // power cycle
+  globalState->setUnitMode(DEFAULT_UNIT_MODE);
+  globalState->setFeedMode(DEFAULT_FEED_MODE);
+  globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+  SessionStore store(&storage);
+  SessionState session;
+  ASSERT_TRUE(store.load(session));
+  session.apply(globalState, &leadscrew);
+
+  ASSERT_EQ(globalState->getMotionMode(), GlobalMotionMode::DISABLED);
+  ASSERT_EQ(globalState->getUnitMode(), GlobalUnitMode::IMPERIAL);
+  ASSERT_EQ(globalState->getFeedMode(), GlobalFeedMode::THREAD);
+  ASSERT_EQ(globalState->getFeedSelect(), 3);
+  ASSERT_FLOAT_EQ(leadscrew.getRatio(), globalState->getCurrentFeedPitch());
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 1234);
+  ASSERT_EQ(leadscrew.getStopPositionState(Leadscrew::StopPosition::LEFT),
+            LeadscrewStopState::SET);
+  ASSERT_EQ(leadscrew.getStopPosition(Leadscrew::StopPosition::LEFT),
+            -5000000);
+  ASSERT_EQ(leadscrew.getStopPositionState(Leadscrew::StopPosition::RIGHT),
+            LeadscrewStopState::UNSET);
+}
+
+TEST_F(SessionTest, TestSavesOnceSettled) {
+  MillisSingleton& millis = MillisSingleton::getInstance();
+  GlobalState* globalState = GlobalState::getInstance();
+  StorageIOMock storage;
+  StepperIOMock stepperIOMock;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &stepperIOMock, 100, 0.1, 100, 1);
+  SessionStore store(&storage);
+
+  // keep changing the pitch, nothing is written while it changes
+  for (int i = 0; i < 10; i++) {
+    globalState->setFeedSelect(i);
+    store.handle(SessionState::capture(globalState, &leadscrew));
+    millis.incrementMillis(ELS_SESSION_SAVE_DELAY_MS / 2);
+  }
+  ASSERT_EQ(storage.m_bytesWritten, 0);
+
+  store.handle(SessionState::capture(globalState, &leadscrew));
+  millis.incrementMillis(ELS_SESSION_SAVE_DELAY_MS / 2);
+  store.handle(SessionState::capture(globalState, &leadscrew));
+  ASSERT_GT(storage.m_bytesWritten, 0);
+
+  // an unchanged session isn't written again
+  int written = storage.m_bytesWritten;
+  millis.incrementMillis(ELS_SESSION_SAVE_DELAY_MS * 2);
+  store.handle(SessionState::capture(globalState, &leadscrew));
+  store.handle(SessionState::capture(globalState, &leadscrew));
+  ASSERT_EQ(storage.m_bytesWritten, written);
+
+  SessionState session;
+  ASSERT_TRUE(store.load(session));
+  ASSERT_EQ(session.feedSelect, 9);
+}
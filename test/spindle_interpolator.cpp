@@ -0,0 +1,90 @@
+#include <gmock/gmock.h>
+#include <spindle_interpolator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// a 4 pulse per revolution sensor split into 100 counts per pulse
+#define COUNTS_PER_PULSE 100
+
+TEST(SpindleInterpolatorTest, TestSteadySpeed) {
+  SpindleInterpolator interpolator(COUNTS_PER_PULSE);
+
+  // a pulse every 10ms, the first two only set the pace
+  interpolator.update(1, 0);
+  interpolator.update(1, 10000);
+  int64_t counts = 2 * COUNTS_PER_PULSE;
+
+  // counts come out evenly in between pulses
+  for (uint64_t micros = 10000; micros < 20000; micros += 1000) {
+    counts += interpolator.update(0, micros);
+    ASSERT_EQ(counts, 2 * COUNTS_PER_PULSE +
+                          (int64_t)(micros - 10000) * COUNTS_PER_PULSE / 10000);
+  }
+  counts += interpolator.update(1, 20000);
+  ASSERT_EQ(counts, 3 * COUNTS_PER_PULSE);
+}
+
+TEST(SpindleInterpolatorTest, TestNeverPassesTheNextPulse) {
+  SpindleInterpolator interpolator(COUNTS_PER_PULSE);
+  interpolator.update(1, 0);
+  interpolator.update(1, 10000);
+  int64_t counts = 2 * COUNTS_PER_PULSE;
+
+  // the spindle stops, the counts wait just short of where the next pulse
+  // would have been
+  for (uint64_t micros = 10000; micros < 100000; micros += 1000) {
+    counts += interpolator.update(0, micros);
+  }
+  ASSERT_EQ(counts, 3 * COUNTS_PER_PULSE - 1);
+
+  // and the other way round, the first pulse back snaps to the sensor
+  counts += interpolator.update(-1, 100000);
+  ASSERT_EQ(counts, COUNTS_PER_PULSE);
+}
+
+TEST(SpindleInterpolatorTest, TestFollowsAcceleration) {
+  SpindleInterpolator interpolator(COUNTS_PER_PULSE);
+
+  // the spindle speeds up at a constant rate, x = a t^2 / 2 in pulses
+  const double accel = 2000;
+  auto pulsesAt = [&](uint64_t micros) {
+    double seconds = micros / 1e6;
+    return (int64_t)(accel * seconds * seconds / 2);
+  };
+
+  int64_t pulses = 0;
+  int64_t counts = 0;
+  double worst = 0;
+  double worstWithoutCompensation = 0;
+  uint64_t lastPulse = 0;
+  uint64_t period = 0;
+  for (uint64_t micros = 20; micros < 200000; micros += 20) {
+    int64_t now = pulsesAt(micros);
+    if (now != pulses) {
+      period = micros - lastPulse;
+      lastPulse = micros;
+    }
+    counts += interpolator.update(now - pulses, micros);
+    pulses = now;
+
+    double actual = accel * (micros / 1e6) * (micros / 1e6) / 2;
+    double error = fabs(counts - actual * COUNTS_PER_PULSE);
+    // what holding the speed of the last pulse would have done
+    double held = pulses * COUNTS_PER_PULSE;
+    if (period != 0) {
+      held += std::min((double)(micros - lastPulse) * COUNTS_PER_PULSE / period,
+                       (double)COUNTS_PER_PULSE - 1);
+    }
+    if (pulses > 4) {
+      worst = std::max(worst, error);
+      worstWithoutCompensation = std::max(
+          worstWithoutCompensation, fabs(held - actual * COUNTS_PER_PULSE));
+    }
+  }
+
+  // never more than a pulse out, and closer than only going by the last one
+  ASSERT_LT(worst, COUNTS_PER_PULSE);
+  ASSERT_LT(worst, worstWithoutCompensation);
+}
@@ -0,0 +1,185 @@
+#include <clock.h>
+#include <config.h>
+#include <cross_slide.h>
+#include <els_elapsedMillis.h>
+#include <globalstate.h>
+#include <gmock/gmock.h>
+#include <leadscrew.h>
+#include <spindle.h>
+#include <step_scheduler.h>
+
+#include "mocks/stepperio_mock.h"
+
+class StepSchedulerTest : public ::testing::Test {
+ protected:
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+
+  void TearDown() override {
+    micros.setMicros(0);
+    GlobalState::getInstance()->setMotionMode(GlobalMotionMode::DISABLED);
+  }
+};
+
+TEST_F(StepSchedulerTest, TestServesEveryAxis) {
+  GlobalState* globalState = GlobalState::getInstance();
+  StepperIOMock leadscrewIO;
+  StepperIOMock crossSlideIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 100, 0.1, 100, 1);
+  CrossSlide crossSlide(&crossSlideIO, nullptr, 100, 0.1, 100, 1);
+
+  StepScheduler scheduler;
+  ASSERT_TRUE(scheduler.addAxis(&leadscrew));
+  ASSERT_TRUE(scheduler.addAxis(&crossSlide));
+
+  globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setRatio(1);
+  // half a revolution of the spindle is 50 steps of the leadscrew
+  spindle.setCurrentPosition(ELS_SPINDLE_ENCODER_PPR / 2);
+  crossSlide.moveTo(2 * NM_PER_MM);
+
+  for (int i = 0; i < 10000; i++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    scheduler.update();
+  }
+
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 50);
+  ASSERT_EQ(crossSlide.getCurrentPosition(), 200);
+  ASSERT_EQ(crossSlide.getCurrentPositionNm(), 2 * NM_PER_MM);
+}
+
+TEST_F(StepSchedulerTest, TestParksIdleAxes) {
+  StepperIOMock crossSlideIO;
+  CrossSlide crossSlide(&crossSlideIO, nullptr, 100, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&crossSlide);
+
+  // nothing to do until it is told to move
+  scheduler.update();
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+
+  crossSlide.moveTo(NM_PER_MM);
+  ASSERT_EQ(crossSlide.getNextUpdateMicros(), 0u);
+
+  // while moving the deadline is the next edge, never in the past
+  micros.incrementMicros(LEADSCREW_TIMER_US);
+  scheduler.update();
+  ASSERT_GT(scheduler.getNextDeadline(), Clock::micros());
+  ASSERT_NE(scheduler.getNextDeadline(), UINT64_MAX);
+
+  while (crossSlide.getCurrentPosition() != 100) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    scheduler.update();
+  }
+  micros.incrementMicros(LEADSCREW_TIMER_US);
+  scheduler.update();
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+}
+
+TEST_F(StepSchedulerTest, TestParksSettledLeadscrew) {
+  StepperIOMock leadscrewIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 100, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  leadscrew.setRatio(1);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+
+  auto run = [&](int micros64) {
+    for (int i = 0; i < micros64 / LEADSCREW_TIMER_US; i++) {
+      micros.incrementMicros(LEADSCREW_TIMER_US);
+      scheduler.update();
+    }
+  };
+
+  // it follows the spindle and parks once the spindle speed has settled
+  spindle.incrementCurrentPosition(ELS_SPINDLE_ENCODER_PPR / 10);
+  run(3 * ELS_SPINDLE_DECEL_WINDOW_US);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 10);
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+
+  // the first spindle count wakes it in the same tick
+  spindle.incrementCurrentPosition(ELS_SPINDLE_ENCODER_PPR / 100);
+  micros.incrementMicros(LEADSCREW_TIMER_US);
+  scheduler.update();
+  ASSERT_EQ(scheduler.getNextDeadline(), 0u);
+  run(3 * ELS_SPINDLE_DECEL_WINDOW_US);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 11);
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+
+  // and so does the main loop
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  ASSERT_EQ(leadscrew.getNextUpdateMicros(), 0u);
+  run(LEADSCREW_TIMER_US);
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+
+  leadscrew.jogDistance(0.1);
+  ASSERT_EQ(leadscrew.getNextUpdateMicros(), 0u);
+  run(1000000);
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 21);
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+
+  // a jog after a long wait ramps up from now rather than from when it parked
+  run(1000000);
+  leadscrew.setJogSpeed(10);
+  run(LEADSCREW_TIMER_US);
+  leadscrew.setJogSpeed(0);
+  run(1000000);
+  ASSERT_LE(leadscrew.getCurrentPosition(), 22);
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+}
+
+TEST_F(StepSchedulerTest, TestAskingForTheDeadlineChangesNothing) {
+  StepperIOMock crossSlideIO;
+  CrossSlide crossSlide(&crossSlideIO, nullptr, 100, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&crossSlide);
+  scheduler.update();
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+
+  // a published change is only picked up by the update it wakes
+  crossSlide.setMotionMode(GlobalMotionMode::ENABLED);
+  ASSERT_EQ(crossSlide.getNextUpdateMicros(), 0u);
+  ASSERT_EQ(crossSlide.getNextUpdateMicros(), 0u);
+  micros.incrementMicros(LEADSCREW_TIMER_US);
+  scheduler.update();
+  ASSERT_EQ(scheduler.getNextDeadline(), UINT64_MAX);
+}
+
+TEST_F(StepSchedulerTest, TestRunsToTheNextEdge) {
+  StepperIOMock leadscrewIO;
+  StepperIOMock crossSlideIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 2000, 0.02, 100, 1);
+  CrossSlide crossSlide(&crossSlideIO, nullptr, 2000, 0.02, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  scheduler.addAxis(&crossSlide);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+
+  // wait for the merged deadline the way the timer callback does
+  int ticks = 0;
+  auto tick = [&]() {
+    scheduler.update();
+    ticks++;
+    uint64_t deadline = scheduler.getNextDeadline();
+    uint64_t now = Clock::micros();
+    uint64_t wait = deadline > now ? deadline - now : 0;
+    wait = std::min(wait, (uint64_t)ELS_IDLE_TIMER_US);
+    micros.incrementMicros(std::max(wait, (uint64_t)LEADSCREW_TIMER_US));
+  };
+
+  // both axes make their moves with a fraction of the ticks of polling
+  leadscrew.jogDistance(1);
+  crossSlide.moveTo(-NM_PER_MM);
+  while (scheduler.getNextDeadline() != UINT64_MAX || ticks == 0) {
+    tick();
+    ASSERT_LT(Clock::micros(), 2000000u);
+  }
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 100);
+  ASSERT_EQ(leadscrewIO.m_motorSteps, 100);
+  ASSERT_FALSE(leadscrew.isJogging());
+  ASSERT_EQ(crossSlide.getCurrentPosition(), -100);
+  ASSERT_LT(ticks, Clock::micros() / LEADSCREW_TIMER_US / 4);
+}
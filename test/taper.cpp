@@ -0,0 +1,224 @@
+#include <config.h>
+#include <cross_slide.h>
+#include <els_elapsedMillis.h>
+#include <globalstate.h>
+#include <gmock/gmock.h>
+#include <leadscrew.h>
+#include <spindle.h>
+#include <step_scheduler.h>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "mocks/stepperio_mock.h"
+
+class TaperTest : public ::testing::Test {
+ protected:
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+
+  void TearDown() override {
+    micros.setMicros(0);
+    GlobalState::getInstance()->setMotionMode(GlobalMotionMode::DISABLED);
+  }
+};
+
+TEST_F(TaperTest, TestFollowsCarriageExactly) {
+  GlobalState* globalState = GlobalState::getInstance();
+  StepperIOMock leadscrewIO;
+  StepperIOMock crossSlideIO;
+  Spindle spindle;
+  // 1mm pitch at 100 steps/rev on both
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 1000, 0.1, 100, 1);
+  CrossSlide crossSlide(&crossSlideIO, &leadscrew, 1000, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  scheduler.addAxis(&crossSlide);
+
+  // a 1:8 taper, one cross slide step every 8 carriage steps
+  leadscrew.setRatio(1);
+  crossSlide.setRatio(0.125);
+  globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  crossSlide.setMotionMode(GlobalMotionMode::ENABLED);
+
+  // turn the spindle slowly enough that neither axis has to ramp up
+  for (int revolution = 0; revolution < 8; revolution++) {
+    for (int pulse = 0; pulse < ELS_SPINDLE_ENCODER_PPR; pulse++) {
+      spindle.incrementCurrentPosition(1);
+      for (int tick = 0; tick < 20; tick++) {
+        micros.incrementMicros(LEADSCREW_TIMER_US);
+        scheduler.update();
+
+        // the cross slide never drifts from the carriage by more than a step
+        int expected = leadscrew.getCurrentPosition() / 8;
+        ASSERT_LE(abs(crossSlide.getCurrentPosition() - expected), 1);
+      }
+    }
+  }
+
+  ASSERT_EQ(leadscrew.getCurrentPosition(), 800);
+  ASSERT_EQ(crossSlide.getCurrentPosition(), 100);
+  ASSERT_EQ(crossSlide.getCurrentPositionNm(), NM_PER_MM);
+}
+
+// the spindle is at speed straight away, the carriage ramps up to it and back
+// down once it stops, the cross slide has to keep up with all of it
+void followRampingCarriage(float crossSlidePitch, float taper) {
+  MicrosSingleton& micros = MicrosSingleton::getInstance();
+  GlobalState* globalState = GlobalState::getInstance();
+  StepperIOMock leadscrewIO;
+  StepperIOMock crossSlideIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 1000, 0.1, 100, 1);
+  CrossSlide crossSlide(&crossSlideIO, &leadscrew, 1000, 0.1, 100,
+                        crossSlidePitch);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  scheduler.addAxis(&crossSlide);
+
+  leadscrew.setRatio(1);
+  crossSlide.setRatio(taper);
+  globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  crossSlide.setMotionMode(GlobalMotionMode::ENABLED);
+
+  // the cross slide sees a carriage step the tick it is counted and takes a
+  // tick to send its own, so it is at most a carriage step behind, in whole
+  // steps of its own. A single step unless it has more steps per mm
+  int64_t stepNm = llround(crossSlidePitch * NM_PER_MM / 100);
+  int64_t carriageStepNm = NM_PER_MM / 100;
+  int64_t maxErrorNm =
+      (int64_t)ceil((float)carriageStepNm * taper / stepNm) * stepNm;
+
+  // a pulse every other tick is 62.5mm/s, the carriage takes a few hundred
+  // steps to get there
+  const int spindleTicks = 200000 / LEADSCREW_TIMER_US;
+  for (int tick = 0; tick < 2 * spindleTicks; tick++) {
+    if (tick < spindleTicks && tick % 2 == 0) {
+      spindle.incrementCurrentPosition(1);
+    }
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    scheduler.update();
+
+    int64_t expected = llround(leadscrew.getCurrentPositionNm() * taper);
+    ASSERT_LE(std::abs(crossSlide.getCurrentPositionNm() - expected),
+              maxErrorNm);
+  }
+
+  int64_t travelNm =
+      (int64_t)spindleTicks / 2 * NM_PER_MM / ELS_SPINDLE_ENCODER_PPR;
+  ASSERT_EQ(leadscrew.getCurrentPositionNm(), travelNm);
+  ASSERT_EQ(crossSlide.getCurrentPositionNm(),
+            llround(travelNm * taper / stepNm) * stepNm);
+}
+
+TEST_F(TaperTest, TestFollowsCarriageRampingToSpeed) {
+  // a steep 1:2 taper
+  followRampingCarriage(1, 0.5);
+}
+
+TEST_F(TaperTest, TestFollowsRampingCarriageWithFinerSteps) {
+  // the steepest taper on a cross slide with more steps per mm than the
+  // carriage, it steps more often than the carriage does
+  followRampingCarriage(0.8, 1);
+}
+
+TEST_F(TaperTest, TestKeepsRampingIntoAMoveWhenFollowingStarts) {
+  GlobalState* globalState = GlobalState::getInstance();
+  StepperIOMock leadscrewIO;
+  StepperIOMock followingIO;
+  StepperIOMock movingIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 1000, 0.1, 100, 1);
+  CrossSlide following(&followingIO, &leadscrew, 1000, 0.1, 100, 1);
+  CrossSlide moving(&movingIO, &leadscrew, 1000, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  scheduler.addAxis(&following);
+  scheduler.addAxis(&moving);
+  following.setRatio(0.5);
+  moving.setRatio(0.5);
+  following.moveTo(50 * NM_PER_MM);
+  moving.moveTo(50 * NM_PER_MM);
+
+  // the leadscrew is enabled part way through the moves, the carriage stands
+  // still so the taper doesn't change where the cross slide is going
+  for (int tick = 0; tick < 2000000 / LEADSCREW_TIMER_US; tick++) {
+    if (tick == 10000 / LEADSCREW_TIMER_US) {
+      globalState->setMotionMode(GlobalMotionMode::ENABLED);
+      leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+      following.setMotionMode(GlobalMotionMode::ENABLED);
+    }
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    scheduler.update();
+
+    // so it finishes its move on the same ramp
+    ASSERT_EQ(following.getCurrentPosition(), moving.getCurrentPosition());
+  }
+  ASSERT_EQ(following.getCurrentPosition(), 5000);
+}
+
+TEST_F(TaperTest, TestFollowsAProfileChangeOnTheCarriage) {
+  GlobalState* globalState = GlobalState::getInstance();
+  StepperIOMock leadscrewIO;
+  StepperIOMock crossSlideIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 1000, 0.1, 100, 1);
+  CrossSlide crossSlide(&crossSlideIO, &leadscrew, 1000, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  scheduler.addAxis(&crossSlide);
+  crossSlide.setRatio(0.5);
+  micros.incrementMicros(LEADSCREW_TIMER_US);
+  scheduler.update();
+
+  // the leadscrew gets a 2mm pitch after the taper was set up
+  MotionConstants constants = leadscrew.getMotionConstants();
+  constants.leadscrewPitch = 2;
+  constants.leadscrewPitchNm = 2 * NM_PER_MM;
+  leadscrew.setMotionConstants(constants);
+
+  leadscrew.setRatio(1);
+  globalState->setMotionMode(GlobalMotionMode::ENABLED);
+  leadscrew.setMotionMode(GlobalMotionMode::ENABLED);
+  crossSlide.setMotionMode(GlobalMotionMode::ENABLED);
+  for (int revolution = 0; revolution < 2; revolution++) {
+    for (int pulse = 0; pulse < ELS_SPINDLE_ENCODER_PPR; pulse++) {
+      spindle.incrementCurrentPosition(1);
+      for (int tick = 0; tick < 20; tick++) {
+        micros.incrementMicros(LEADSCREW_TIMER_US);
+        scheduler.update();
+      }
+    }
+  }
+
+  // 2mm of carriage travel in 100 steps is 1mm of cross slide
+  ASSERT_EQ(leadscrew.getCurrentPositionNm(), 2 * NM_PER_MM);
+  ASSERT_EQ(crossSlide.getCurrentPositionNm(), NM_PER_MM);
+}
+
+TEST_F(TaperTest, TestOnlyFollowsWhileEnabled) {
+  GlobalState* globalState = GlobalState::getInstance();
+  StepperIOMock leadscrewIO;
+  StepperIOMock crossSlideIO;
+  Spindle spindle;
+  Leadscrew leadscrew(&spindle, &leadscrewIO, 100, 0.1, 100, 1);
+  CrossSlide crossSlide(&crossSlideIO, &leadscrew, 100, 0.1, 100, 1);
+  StepScheduler scheduler;
+  scheduler.addAxis(&leadscrew);
+  scheduler.addAxis(&crossSlide);
+  crossSlide.setRatio(0.5);
+
+  // jogging the carriage back doesn't move the cross slide
+  globalState->setMotionMode(GlobalMotionMode::JOG);
+  leadscrew.setMotionMode(GlobalMotionMode::JOG);
+  crossSlide.setMotionMode(GlobalMotionMode::JOG);
+  leadscrew.jogDistance(-1);
+  for (int i = 0; i < 10000; i++) {
+    micros.incrementMicros(LEADSCREW_TIMER_US);
+    scheduler.update();
+  }
+  ASSERT_EQ(leadscrew.getCurrentPosition(), -100);
+  ASSERT_EQ(crossSlide.getCurrentPosition(), 0);
+  ASSERT_EQ(crossSlide.getNextUpdateMicros(), UINT64_MAX);
+}